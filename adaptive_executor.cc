@@ -0,0 +1,218 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "adaptive_executor.h"
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace futures {
+
+namespace {
+
+// Every run is timed until a site has this many samples, after that only
+// one in kSampleInterval runs pays for reading the clock
+constexpr uint64_t kWarmupRuns = 8;
+constexpr uint64_t kSampleInterval = 16;
+
+} // namespace
+
+class AdaptiveExecutor::Site : public Executor {
+public:
+  using RunFn = void (*)(IntrusiveTask *);
+
+  Site(AdaptiveExecutor *owner, const void *tag) : owner_(owner), tag_(tag) {}
+
+  void Spawn(Task task) override { owner_->SpawnAt(this, std::move(task)); }
+  void SpawnIntrusive(IntrusiveTask *task) override {
+    owner_->SpawnIntrusiveAt(this, task);
+  }
+
+  // Sites are referenced by their owner and by every timed task in flight,
+  // since a task may finish after the owner is gone
+  void Ref() { refs_.fetch_add(1, std::memory_order_relaxed); }
+  void Unref() {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  bool ShouldSample() {
+    uint64_t run = runs_.fetch_add(1, std::memory_order_relaxed);
+    return run < kWarmupRuns || run % kSampleInterval == 0;
+  }
+
+  template <typename Fn> void RunTimed(Fn &&task) {
+    auto start = std::chrono::steady_clock::now();
+    std::forward<Fn>(task)();
+    Record(std::chrono::steady_clock::now() - start);
+  }
+
+  void Record(std::chrono::nanoseconds duration) {
+    // Weight new samples by 1/8, racing updates may drop a sample which is
+    // fine for an estimate
+    int64_t sample = duration.count();
+    int64_t old = estimate_ns_.load(std::memory_order_relaxed);
+    int64_t updated = old < 0 ? sample : old + (sample - old) / 8;
+    estimate_ns_.store(updated, std::memory_order_relaxed);
+  }
+
+  std::chrono::nanoseconds estimate() const {
+    return std::chrono::nanoseconds(
+        estimate_ns_.load(std::memory_order_relaxed));
+  }
+
+  /// Time `task` when it runs on the wrapped executor by putting TimedRun in
+  /// front of its run function.  Returns false if it cannot be timed.
+  bool ChainTimedRun(IntrusiveTask *task) {
+    // There is no room in the task for its own run function, so it is kept
+    // here.  Tasks of one site almost always share one, a task with a
+    // different one is simply not timed.
+    RunFn expected = nullptr;
+    if (!chained_run_.compare_exchange_strong(expected, task->run,
+                                              std::memory_order_relaxed) &&
+        expected != task->run) {
+      return false;
+    }
+    Ref();
+    task->run = &TimedRun;
+    task->site = this;
+    return true;
+  }
+
+private:
+  static void TimedRun(IntrusiveTask *task) {
+    auto *site = static_cast<Site *>(const_cast<void *>(task->site));
+    // Restore the task first, it may spawn itself again from `run`
+    RunFn run = site->chained_run_.load(std::memory_order_relaxed);
+    task->run = run;
+    task->site = site->tag_;
+    site->RunTimed([&] { run(task); });
+    site->Unref();
+  }
+
+  AdaptiveExecutor *owner_;
+  const void *tag_;
+  std::atomic<int> refs_{1};
+  std::atomic<uint64_t> runs_{0};
+  std::atomic<int64_t> estimate_ns_{-1};
+  std::atomic<RunFn> chained_run_{nullptr};
+};
+
+AdaptiveExecutor::AdaptiveExecutor(Executor *executor,
+                                   std::chrono::nanoseconds inline_threshold)
+    : executor_(executor), inline_threshold_(inline_threshold) {}
+
+AdaptiveExecutor::~AdaptiveExecutor() {
+  for (SiteShard &shard : site_shards_) {
+    for (auto &entry : shard.sites) {
+      entry.second->Unref();
+    }
+  }
+}
+
+void AdaptiveExecutor::Spawn(Task task) {
+  SpawnAt(GetSite(&task.target_type()), std::move(task));
+}
+
+void AdaptiveExecutor::SpawnIntrusive(IntrusiveTask *task) {
+  // Every future reaches here through the same wrapper, so keying on its
+  // type would lump all futures into one site
+  const void *tag = task->site;
+  if (tag == nullptr) {
+    tag = reinterpret_cast<const void *>(task->run);
+  }
+  SpawnIntrusiveAt(GetSite(tag), task);
+}
+
+Executor *AdaptiveExecutor::ForSite(const void *tag) { return GetSite(tag); }
+
+std::chrono::nanoseconds AdaptiveExecutor::EstimatedCost(const void *tag) {
+  return GetSite(tag)->estimate();
+}
+
+AdaptiveExecutor::Site *AdaptiveExecutor::GetSite(const void *tag) {
+  // Tags are type_info objects or static variables, drop the low bits that
+  // alignment keeps the same
+  SiteShard &shard =
+      site_shards_[(reinterpret_cast<uintptr_t>(tag) >> 4) % kNumSiteShards];
+  {
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.sites.find(tag);
+    if (it != shard.sites.end()) [[likely]] {
+      return it->second;
+    }
+  }
+  std::lock_guard<std::shared_mutex> lock(shard.mutex);
+  auto &site = shard.sites[tag];
+  if (site == nullptr) {
+    site = new Site(this, tag);
+  }
+  return site;
+}
+
+void AdaptiveExecutor::SpawnAt(Site *site, Task task) {
+  const bool sample = site->ShouldSample();
+  const std::chrono::nanoseconds estimate = site->estimate();
+  if (estimate.count() >= 0 && estimate < inline_threshold_ &&
+      internal::inline_depth < kMaxInlineDepth) {
+    internal::inline_depth++;
+    if (sample) {
+      site->RunTimed(std::move(task));
+    } else {
+      std::move(task)();
+    }
+    internal::inline_depth--;
+    return;
+  }
+  if (sample) {
+    // The task may finish after this executor is gone so it keeps the site
+    // alive itself
+    site->Ref();
+    executor_->Spawn([site, task = std::move(task)]() mutable {
+      site->RunTimed(std::move(task));
+      site->Unref();
+    });
+  } else {
+    executor_->Spawn(std::move(task));
+  }
+}
+
+void AdaptiveExecutor::SpawnIntrusiveAt(Site *site, IntrusiveTask *task) {
+  const bool sample = site->ShouldSample();
+  const std::chrono::nanoseconds estimate = site->estimate();
+  if (estimate.count() >= 0 && estimate < inline_threshold_ &&
+      internal::inline_depth < kMaxInlineDepth) {
+    internal::inline_depth++;
+    if (sample) {
+      site->RunTimed([task] { task->run(task); });
+    } else {
+      task->run(task);
+    }
+    internal::inline_depth--;
+    return;
+  }
+  // Passed on as is so that the wrapped executor can queue it without
+  // allocating
+  if (sample) {
+    site->ChainTimedRun(task);
+  }
+  executor_->SpawnIntrusive(task);
+}
+
+} // namespace futures
@@ -0,0 +1,81 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "future.h"
+
+namespace futures {
+
+/// \brief Decides per call site whether work is cheap enough to run inline
+///
+/// Keeps a running estimate (an exponentially weighted moving average) of
+/// how long the tasks from each site take.  Tasks whose site is estimated to
+/// take less than the threshold run inline on the calling thread, everything
+/// else (including sites with no estimate yet) is spawned on the wrapped
+/// executor.  Sites are identified by an explicit tag through ForSite.
+/// Otherwise a future's site is the type of the last callable in its chain,
+/// and a task spawned directly is keyed by the type of its callable.
+class AdaptiveExecutor : public Executor {
+public:
+  explicit AdaptiveExecutor(Executor *executor,
+                            std::chrono::nanoseconds inline_threshold =
+                                std::chrono::microseconds(20));
+  virtual ~AdaptiveExecutor();
+
+  /// \brief Spawn a task, using the type of the callable as its site
+  void Spawn(Task task) override;
+  /// \brief Spawn a future's task, using the site recorded on it
+  void SpawnIntrusive(IntrusiveTask *task) override;
+
+  /// \brief An executor whose tasks all count as the site `tag`
+  ///
+  /// Use this as the executor of a future to give it its own estimate.  The
+  /// returned executor lives as long as this one.
+  Executor *ForSite(const void *tag);
+
+  /// \brief The current estimate for a site, negative if it has none yet
+  std::chrono::nanoseconds EstimatedCost(const void *tag);
+
+private:
+  class Site;
+
+  // Sites are looked up on every spawn.  They are spread over shards that
+  // are almost only ever read so lookups do not serialize on one lock.
+  struct SiteShard {
+    std::shared_mutex mutex;
+    // Each holds a reference to its site
+    std::unordered_map<const void *, Site *> sites;
+  };
+  static constexpr size_t kNumSiteShards = 16;
+
+  Site *GetSite(const void *tag);
+  void SpawnAt(Site *site, Task task);
+  void SpawnIntrusiveAt(Site *site, IntrusiveTask *task);
+
+  Executor *executor_;
+  const std::chrono::nanoseconds inline_threshold_;
+  std::array<SiteShard, kNumSiteShards> site_shards_;
+};
+
+} // namespace futures
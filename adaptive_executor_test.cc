@@ -0,0 +1,170 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <typeinfo>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+#include "adaptive_executor.h"
+#include "future.h"
+
+namespace futures {
+
+// Runs a future on `executor` and waits for it, returning the thread it ran
+// on
+std::thread::id RunAndWait(Executor *executor,
+                           std::chrono::microseconds work = {}) {
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool done = false;
+  std::thread::id ran_on;
+  LazyFuture<void> fut(
+      [&] {
+        ran_on = std::this_thread::get_id();
+        if (work.count() > 0) {
+          std::this_thread::sleep_for(work);
+        }
+        return Status::OK();
+      },
+      executor);
+  std::move(fut).ConsumeAsync([&](Status) {
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+    cv.notify_one();
+  });
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&] { return done; });
+  return ran_on;
+}
+
+// Runs a future ending in `continuation` on `executor` and waits for it,
+// returning the thread it ran on
+template <typename Fn>
+std::thread::id RunThenAndWait(Executor *executor, Fn continuation) {
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool done = false;
+  std::thread::id ran_on;
+  Supplier<int> supplier = []() -> Result<int> { return 0; };
+  LazyFuture<int> fut = LazyFuture<int>(std::move(supplier), executor)
+                            .Then<int>(std::move(continuation));
+  std::move(fut).ConsumeAsync([&](Result<int>) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ran_on = std::this_thread::get_id();
+    done = true;
+    cv.notify_one();
+  });
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&] { return done; });
+  return ran_on;
+}
+
+TEST(AdaptiveExecutorTest, CheapSitesRunInline) {
+  static const char kCheap = 0;
+  ThreadPoolExecutor pool(1);
+  AdaptiveExecutor executor(&pool, std::chrono::milliseconds(1));
+  std::thread::id main_thread_id = std::this_thread::get_id();
+
+  // No estimate yet so the first run goes to the pool
+  ASSERT_NE(main_thread_id, RunAndWait(executor.ForSite(&kCheap)));
+  // The sample is recorded after the consumer runs, wait for the worker
+  RunAndWait(&pool);
+  ASSERT_GE(executor.EstimatedCost(&kCheap).count(), 0);
+  ASSERT_EQ(main_thread_id, RunAndWait(executor.ForSite(&kCheap)));
+}
+
+TEST(AdaptiveExecutorTest, ExpensiveSitesSpawn) {
+  static const char kExpensive = 0;
+  ThreadPoolExecutor pool(1);
+  AdaptiveExecutor executor(&pool, std::chrono::microseconds(100));
+  std::thread::id main_thread_id = std::this_thread::get_id();
+
+  for (int i = 0; i < 4; i++) {
+    ASSERT_NE(main_thread_id, RunAndWait(executor.ForSite(&kExpensive),
+                                         std::chrono::milliseconds(1)));
+    RunAndWait(&pool);
+  }
+  ASSERT_GE(executor.EstimatedCost(&kExpensive),
+            std::chrono::milliseconds(1));
+}
+
+TEST(AdaptiveExecutorTest, KeyedByCallableType) {
+  ThreadPoolExecutor pool(1);
+  AdaptiveExecutor executor(&pool, std::chrono::milliseconds(1));
+  std::thread::id main_thread_id = std::this_thread::get_id();
+
+  ASSERT_NE(main_thread_id, RunAndWait(&executor));
+  RunAndWait(&pool);
+  ASSERT_EQ(main_thread_id, RunAndWait(&executor));
+}
+
+TEST(AdaptiveExecutorTest, FuturesKeyedByContinuation) {
+  ThreadPoolExecutor pool(1);
+  AdaptiveExecutor executor(&pool, std::chrono::microseconds(500));
+  std::thread::id main_thread_id = std::this_thread::get_id();
+  auto cheap = [](Result<int> val) { return val; };
+  auto expensive = [](Result<int> val) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    return val;
+  };
+
+  for (int i = 0; i < 4; i++) {
+    RunThenAndWait(&executor, cheap);
+    RunThenAndWait(&executor, expensive);
+    // The samples are recorded after the consumers run, wait for the worker
+    RunAndWait(&pool);
+  }
+  ASSERT_LT(executor.EstimatedCost(&typeid(cheap)),
+            std::chrono::microseconds(500));
+  ASSERT_GE(executor.EstimatedCost(&typeid(expensive)),
+            std::chrono::milliseconds(2));
+  ASSERT_EQ(main_thread_id, RunThenAndWait(&executor, cheap));
+  ASSERT_NE(main_thread_id, RunThenAndWait(&executor, expensive));
+}
+
+// Passes tasks on to another executor, counting how they arrive
+class CountingExecutor : public Executor {
+public:
+  explicit CountingExecutor(Executor *executor) : executor_(executor) {}
+
+  void Spawn(Task task) override {
+    spawned++;
+    executor_->Spawn(std::move(task));
+  }
+  void SpawnIntrusive(IntrusiveTask *task) override {
+    spawned_intrusive++;
+    executor_->SpawnIntrusive(task);
+  }
+
+  std::atomic<int> spawned{0};
+  std::atomic<int> spawned_intrusive{0};
+
+private:
+  Executor *executor_;
+};
+
+TEST(AdaptiveExecutorTest, FuturesStayIntrusive) {
+  ThreadPoolExecutor pool(1);
+  CountingExecutor counting(&pool);
+  AdaptiveExecutor executor(&counting, std::chrono::microseconds(100));
+  auto expensive = [](Result<int> val) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return val;
+  };
+
+  // Every run is sampled while warming up, the timing must not need the task
+  // to be wrapped
+  for (int i = 0; i < 4; i++) {
+    RunThenAndWait(&executor, expensive);
+    RunAndWait(&pool);
+  }
+  ASSERT_EQ(0, counting.spawned.load());
+  ASSERT_EQ(4, counting.spawned_intrusive.load());
+  ASSERT_GE(executor.EstimatedCost(&typeid(expensive)),
+            std::chrono::milliseconds(1));
+}
+
+} // namespace futures
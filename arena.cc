@@ -0,0 +1,189 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "arena.h"
+
+#include <atomic>
+#include <cstdint>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace futures {
+
+struct alignas(64) Arena::Chunk {
+  Arena *arena;
+  // One per live allocation plus one while a lane is bumping the chunk
+  std::atomic<int64_t> refs;
+};
+
+struct alignas(64) Arena::Lane {
+  // Only contended once more than kArenaLanes threads allocate
+  std::mutex mutex;
+  Chunk *chunk = nullptr;
+  size_t offset = 0;
+};
+
+namespace {
+
+// Precedes every allocation so Free can find where it came from
+struct alignas(kArenaAlignment) AllocationHeader {
+  void *chunk;
+};
+
+constexpr size_t kHeaderSize = sizeof(AllocationHeader);
+
+constexpr size_t RoundUp(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+int ThreadLane() {
+  static std::atomic<int> next_lane{0};
+  thread_local int lane = next_lane.fetch_add(1) % kArenaLanes;
+  return lane;
+}
+
+void *MapChunk(size_t size, HugePages huge_pages) {
+#ifdef __linux__
+  if (huge_pages == HugePages::Explicit) {
+    void *chunk = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (chunk != MAP_FAILED) {
+      return chunk;
+    }
+  }
+  // The kernel only backs aligned ranges with transparent huge pages so map
+  // twice the size and trim it down to an aligned chunk
+  void *raw = mmap(nullptr, 2 * size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  const uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+  const uintptr_t aligned = RoundUp(start, size);
+  if (aligned > start) {
+    munmap(raw, aligned - start);
+  }
+  munmap(reinterpret_cast<void *>(aligned + size), start + size - aligned);
+  if (huge_pages != HugePages::None) {
+    // Only advice, the chunk still works on kernels without THP
+    madvise(reinterpret_cast<void *>(aligned), size, MADV_HUGEPAGE);
+  }
+  return reinterpret_cast<void *>(aligned);
+#else
+  (void)huge_pages;
+  return ::operator new(size, std::align_val_t(size));
+#endif
+}
+
+void UnmapChunk(void *chunk, size_t size) {
+#ifdef __linux__
+  munmap(chunk, size);
+#else
+  ::operator delete(chunk, std::align_val_t(size));
+#endif
+}
+
+} // namespace
+
+Arena::Arena(ArenaOptions options)
+    : options_(options), lanes_(new Lane[kArenaLanes]) {}
+
+Arena::~Arena() {
+  for (auto *chunk : chunks_) {
+    chunk->~Chunk();
+    UnmapChunk(chunk, options_.chunk_size);
+  }
+}
+
+void *Arena::Allocate(size_t size) {
+  const size_t total = RoundUp(kHeaderSize + size, kArenaAlignment);
+  if (total > options_.chunk_size - sizeof(Chunk)) {
+    return AllocateHeap(size);
+  }
+  Lane &lane = lanes_[ThreadLane()];
+  std::lock_guard<std::mutex> lock(lane.mutex);
+  if (lane.chunk == nullptr || lane.offset + total > options_.chunk_size) {
+    Chunk *full = lane.chunk;
+    lane.chunk = NewChunk();
+    lane.offset = sizeof(Chunk);
+    if (full != nullptr) {
+      Release(full);
+    }
+  }
+  auto *header = reinterpret_cast<AllocationHeader *>(
+      reinterpret_cast<unsigned char *>(lane.chunk) + lane.offset);
+  lane.offset += total;
+  lane.chunk->refs.fetch_add(1, std::memory_order_relaxed);
+  header->chunk = lane.chunk;
+  return header + 1;
+}
+
+void *Arena::AllocateHeap(size_t size) {
+  auto *header =
+      static_cast<AllocationHeader *>(::operator new(kHeaderSize + size));
+  header->chunk = nullptr;
+  return header + 1;
+}
+
+void Arena::Free(void *ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  auto *header = static_cast<AllocationHeader *>(ptr) - 1;
+  auto *chunk = static_cast<Chunk *>(header->chunk);
+  if (chunk == nullptr) {
+    ::operator delete(header);
+    return;
+  }
+  chunk->arena->Release(chunk);
+}
+
+Arena::Chunk *Arena::NewChunk() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Chunk *chunk;
+  if (!free_chunks_.empty()) {
+    chunk = free_chunks_.back();
+    free_chunks_.pop_back();
+  } else {
+    chunk = new (MapChunk(options_.chunk_size, options_.huge_pages)) Chunk;
+    chunk->arena = this;
+    chunks_.push_back(chunk);
+  }
+  chunk->refs.store(1, std::memory_order_relaxed);
+  return chunk;
+}
+
+void Arena::Release(Chunk *chunk) {
+  if (chunk->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_chunks_.push_back(chunk);
+  }
+}
+
+int Arena::num_chunks() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<int>(chunks_.size());
+}
+
+int Arena::num_free_chunks() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<int>(free_chunks_.size());
+}
+
+} // namespace futures
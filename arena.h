@@ -0,0 +1,164 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace futures {
+
+enum class HugePages : char {
+  /// Regular pages
+  None = 0,
+  /// Ask for transparent huge pages with madvise(MADV_HUGEPAGE)
+  Transparent = 1,
+  /// Explicit huge pages from the hugetlbfs pool (MAP_HUGETLB), falls back to
+  /// transparent huge pages if none are reserved
+  Explicit = 2
+};
+
+struct ArenaOptions {
+  HugePages huge_pages = HugePages::Transparent;
+  /// Size (and alignment) of each chunk mapped from the OS, one huge page by
+  /// default
+  size_t chunk_size = 2 * 1024 * 1024;
+};
+
+/// \brief Threads beyond this many share bump pointers
+constexpr int kArenaLanes = 64;
+
+/// \brief Alignment of every arena allocation
+constexpr size_t kArenaAlignment = alignof(std::max_align_t);
+
+/// \brief Bump allocator for small, short-lived allocations backed by huge
+/// pages
+///
+/// Memory is mapped from the OS in large chunks and handed out by bumping a
+/// pointer, so many small objects end up densely packed in a few huge pages
+/// instead of scattered over 4K pages.  Each thread bumps its own chunk (up
+/// to kArenaLanes threads, after that threads share).  A chunk is recycled
+/// once everything allocated from it has been freed.
+///
+/// Every allocation still locks its lane's mutex, since lanes may be shared.
+/// With no more than kArenaLanes threads the lock is never contended and
+/// costs an uncontended lock/unlock pair, with more threads it serializes
+/// the threads sharing a lane.
+///
+/// Allocations larger than a chunk fall back to the regular heap.  Memory
+/// may be freed from any thread but the arena must outlive every allocation.
+class Arena {
+public:
+  explicit Arena(ArenaOptions options = {});
+  ~Arena();
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  void *Allocate(size_t size);
+  /// \brief Allocate from the regular heap in a way Free can release
+  static void *AllocateHeap(size_t size);
+  /// \brief Free memory returned by Allocate (on any arena) or AllocateHeap
+  static void Free(void *ptr);
+
+  /// \brief The number of chunks currently mapped
+  int num_chunks();
+  /// \brief The number of mapped chunks with nothing allocated from them
+  int num_free_chunks();
+
+private:
+  struct Chunk;
+  struct Lane;
+
+  Chunk *NewChunk();
+  void Release(Chunk *chunk);
+
+  const ArenaOptions options_;
+  std::unique_ptr<Lane[]> lanes_;
+  std::mutex mutex_;
+  std::vector<Chunk *> chunks_;
+  std::vector<Chunk *> free_chunks_;
+};
+
+namespace internal {
+
+inline thread_local Arena *current_arena = nullptr;
+
+/// \brief Allocate from the current thread's arena, or the heap if it has
+/// none.  Must be released with FreeFrame.
+inline void *AllocateFrame(size_t size) {
+  if (current_arena != nullptr) {
+    return current_arena->Allocate(size);
+  }
+  return Arena::AllocateHeap(size);
+}
+
+inline void FreeFrame(void *ptr) { Arena::Free(ptr); }
+
+/// \brief `new` for frames that should come from the current arena
+template <typename T, typename... Args> T *NewFrame(Args &&...args) {
+  static_assert(alignof(T) <= kArenaAlignment, "over-aligned type");
+  return new (AllocateFrame(sizeof(T))) T(std::forward<Args>(args)...);
+}
+
+template <typename T> void DeleteFrame(T *frame) {
+  frame->~T();
+  FreeFrame(frame);
+}
+
+} // namespace internal
+
+/// \brief A standard allocator drawing from the current thread's arena
+///
+/// Useful for payload buffers, e.g. `std::vector<char, ArenaAllocator<char>>`.
+/// Memory may be freed on any thread.
+template <typename T> struct ArenaAllocator {
+  using value_type = T;
+
+  ArenaAllocator() = default;
+  template <typename U> ArenaAllocator(const ArenaAllocator<U> &) {}
+
+  T *allocate(size_t n) {
+    static_assert(alignof(T) <= kArenaAlignment, "over-aligned type");
+    return static_cast<T *>(internal::AllocateFrame(n * sizeof(T)));
+  }
+  void deallocate(T *ptr, size_t) { internal::FreeFrame(ptr); }
+
+  template <typename U> bool operator==(const ArenaAllocator<U> &) const {
+    return true;
+  }
+};
+
+/// \brief Allocate LazyFuture task frames and chain state made on this thread
+/// from `arena` for the lifetime of the scope
+class ScopedArena {
+public:
+  explicit ScopedArena(Arena *arena) : previous_(internal::current_arena) {
+    internal::current_arena = arena;
+  }
+  ~ScopedArena() { internal::current_arena = previous_; }
+  ScopedArena(const ScopedArena &) = delete;
+  ScopedArena &operator=(const ScopedArena &) = delete;
+
+private:
+  Arena *previous_;
+};
+
+} // namespace futures
@@ -0,0 +1,99 @@
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "arena.h"
+#include "future.h"
+
+namespace futures {
+
+TEST(ArenaTest, AllocationsAreAlignedAndDistinct) {
+  Arena arena;
+  void *a = arena.Allocate(1);
+  void *b = arena.Allocate(100);
+  ASSERT_EQ(0, reinterpret_cast<uintptr_t>(a) % kArenaAlignment);
+  ASSERT_EQ(0, reinterpret_cast<uintptr_t>(b) % kArenaAlignment);
+  ASSERT_GE(static_cast<char *>(b) - static_cast<char *>(a), 1);
+  ASSERT_EQ(1, arena.num_chunks());
+  Arena::Free(a);
+  Arena::Free(b);
+}
+
+TEST(ArenaTest, ChunksAreRecycled) {
+  ArenaOptions options;
+  options.huge_pages = HugePages::None;
+  options.chunk_size = 64 * 1024;
+  Arena arena(options);
+  std::vector<void *> allocations;
+  for (int i = 0; i < 1000; i++) {
+    allocations.push_back(arena.Allocate(1000));
+  }
+  const int num_chunks = arena.num_chunks();
+  ASSERT_GT(num_chunks, 1);
+  // The chunk still being bumped is not free
+  ASSERT_EQ(0, arena.num_free_chunks());
+  for (void *ptr : allocations) {
+    Arena::Free(ptr);
+  }
+  ASSERT_EQ(num_chunks - 1, arena.num_free_chunks());
+  for (int i = 0; i < 1000; i++) {
+    Arena::Free(arena.Allocate(1000));
+  }
+  ASSERT_EQ(num_chunks, arena.num_chunks());
+}
+
+TEST(ArenaTest, LargeAllocationsUseTheHeap) {
+  ArenaOptions options;
+  options.chunk_size = 64 * 1024;
+  Arena arena(options);
+  void *ptr = arena.Allocate(1024 * 1024);
+  ASSERT_EQ(0, arena.num_chunks());
+  Arena::Free(ptr);
+}
+
+TEST(ArenaTest, FuturesAllocateFromScopedArena) {
+  Arena arena;
+  ThreadPoolExecutor pool(2);
+  std::mutex mutex;
+  std::condition_variable cv;
+  int done = 0;
+  std::vector<int> values(100);
+  {
+    ScopedArena scope(&arena);
+    for (int i = 0; i < 100; i++) {
+      LazyFuture<int> fut([i] { return Result<int>(i); }, &pool);
+      std::move(fut)
+          .Then<int>([](Result<int> value) { return Result<int>(*value * 2); })
+          .Yield()
+          .ConsumeAsync([&, i](Result<int> value) {
+            std::lock_guard<std::mutex> lock(mutex);
+            values[i] = *value;
+            done++;
+            cv.notify_one();
+          });
+    }
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&] { return done == 100; });
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(i * 2, values[i]);
+  }
+  ASSERT_EQ(1, arena.num_chunks());
+}
+
+TEST(ArenaTest, Allocator) {
+  Arena arena;
+  ScopedArena scope(&arena);
+  std::vector<char, ArenaAllocator<char>> buffer(4096, 'x');
+  ASSERT_EQ(1, arena.num_chunks());
+  buffer.resize(8192, 'y');
+  ASSERT_EQ('x', buffer[0]);
+  ASSERT_EQ('y', buffer[8191]);
+}
+
+} // namespace futures
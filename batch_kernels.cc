@@ -0,0 +1,441 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "batch_kernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define FUTURES_HAVE_X86_KERNELS 1
+#endif
+
+namespace futures {
+
+namespace {
+
+// Kernels scan statuses as an array of state pointers, null meaning OK
+static_assert(sizeof(Status) == sizeof(void *));
+
+uint64_t LoadWord(const uint64_t *bitmap, int64_t word, int64_t length) {
+  const int64_t remaining = length - word * 64;
+  uint64_t bits = bitmap[word];
+  if (remaining < 64) {
+    // Bits past the end count as set so they never look like errors
+    bits |= ~uint64_t{0} << remaining;
+  }
+  return bits;
+}
+
+int64_t NumWords(int64_t length) { return (length + 63) / 64; }
+
+int64_t ScalarFindFirstUnset(const uint64_t *bitmap, int64_t first_word,
+                             int64_t length) {
+  for (int64_t w = first_word; w < NumWords(length); w++) {
+    const uint64_t unset = ~LoadWord(bitmap, w, length);
+    if (unset != 0) {
+      return w * 64 + std::countr_zero(unset);
+    }
+  }
+  return -1;
+}
+
+int64_t ScalarCountSet(const uint64_t *bitmap, int64_t first_word,
+                       int64_t length) {
+  int64_t count = 0;
+  for (int64_t w = first_word; w < NumWords(length); w++) {
+    count += std::popcount(bitmap[w]);
+  }
+  return count;
+}
+
+// Copies bytes rather than typed values since the kernels are shared by every
+// trivially copyable type of the same width
+template <size_t kWidth>
+int64_t ScalarCompact(const void *values, const uint64_t *bitmap,
+                      int64_t first, int64_t length, void *out) {
+  const auto *in = static_cast<const unsigned char *>(values);
+  auto *dest = static_cast<unsigned char *>(out);
+  int64_t n = 0;
+  for (int64_t i = first; i < length; i++) {
+    if ((bitmap[i / 64] >> (i % 64)) & 1) {
+      std::memcpy(dest + n * kWidth, in + i * kWidth, kWidth);
+      n++;
+    }
+  }
+  return n;
+}
+
+int64_t ScalarFindFirstError(const Status *statuses, int64_t first,
+                             int64_t length) {
+  for (int64_t i = first; i < length; i++) {
+    if (!statuses[i].ok()) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+#ifdef FUTURES_HAVE_X86_KERNELS
+
+// AVX2
+
+__attribute__((target("avx2"))) int64_t
+Avx2FindFirstUnset(const uint64_t *bitmap, int64_t length) {
+  const int64_t full_words = length / 64;
+  const __m256i ones = _mm256_set1_epi64x(-1);
+  int64_t w = 0;
+  for (; w + 4 <= full_words; w += 4) {
+    const __m256i words =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bitmap + w));
+    const int all_set = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(words, ones)));
+    if (all_set != 0xF) {
+      const int64_t lane = std::countr_zero(static_cast<unsigned>(~all_set));
+      return (w + lane) * 64 + std::countr_zero(~bitmap[w + lane]);
+    }
+  }
+  return ScalarFindFirstUnset(bitmap, w, length);
+}
+
+// Counts bits a nibble at a time with a shuffle lookup (Mula et al.)
+__attribute__((target("avx2"))) int64_t Avx2CountSet(const uint64_t *bitmap,
+                                                     int64_t length) {
+  const int64_t num_words = NumWords(length);
+  const __m256i lookup =
+      _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1,
+                       1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+  __m256i totals = _mm256_setzero_si256();
+  int64_t w = 0;
+  for (; w + 4 <= num_words; w += 4) {
+    const __m256i words =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bitmap + w));
+    const __m256i low = _mm256_and_si256(words, low_nibble);
+    const __m256i high =
+        _mm256_and_si256(_mm256_srli_epi16(words, 4), low_nibble);
+    const __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low),
+                                           _mm256_shuffle_epi8(lookup, high));
+    totals = _mm256_add_epi64(totals,
+                              _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+  }
+  alignas(32) int64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), totals);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+         ScalarCountSet(bitmap, w, length);
+}
+
+// For each 8-bit mask, the lanes to gather so the selected ones end up first
+struct Compact32Table {
+  Compact32Table() {
+    for (int mask = 0; mask < 256; mask++) {
+      int n = 0;
+      for (int lane = 0; lane < 8; lane++) {
+        if (mask & (1 << lane)) {
+          permutations[mask][n++] = lane;
+        }
+      }
+      for (; n < 8; n++) {
+        permutations[mask][n] = 0;
+      }
+    }
+    for (int count = 0; count <= 8; count++) {
+      for (int lane = 0; lane < 8; lane++) {
+        store_masks[count][lane] = lane < count ? -1 : 0;
+      }
+    }
+  }
+  alignas(32) int32_t permutations[256][8];
+  alignas(32) int32_t store_masks[9][8];
+};
+
+const Compact32Table &GetCompact32Table() {
+  static const Compact32Table table;
+  return table;
+}
+
+__attribute__((target("avx2"))) int64_t
+Avx2CompactSet32(const void *values, const uint64_t *bitmap, int64_t length,
+                 void *out) {
+  const auto &table = GetCompact32Table();
+  const auto *in = static_cast<const int32_t *>(values);
+  auto *dest = static_cast<int32_t *>(out);
+  int64_t n = 0;
+  int64_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    const unsigned mask = (bitmap[i / 64] >> (i % 64)) & 0xFF;
+    if (mask == 0) {
+      continue;
+    }
+    const __m256i lanes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+    const __m256i packed = _mm256_permutevar8x32_epi32(
+        lanes, _mm256_load_si256(
+                   reinterpret_cast<const __m256i *>(table.permutations[mask])));
+    const int count = std::popcount(mask);
+    // A masked store so nothing is written past the last selected value
+    _mm256_maskstore_epi32(dest + n,
+                           _mm256_load_si256(reinterpret_cast<const __m256i *>(
+                               table.store_masks[count])),
+                           packed);
+    n += count;
+  }
+  return n + ScalarCompact<sizeof(*in)>(in, bitmap, i, length, dest + n);
+}
+
+__attribute__((target("avx2"))) int64_t
+Avx2CompactSet64(const void *values, const uint64_t *bitmap, int64_t length,
+                 void *out) {
+  const auto &table = GetCompact32Table();
+  const auto *in = static_cast<const int64_t *>(values);
+  auto *dest = static_cast<int64_t *>(out);
+  int64_t n = 0;
+  int64_t i = 0;
+  for (; i + 4 <= length; i += 4) {
+    const unsigned mask = (bitmap[i / 64] >> (i % 64)) & 0xF;
+    if (mask == 0) {
+      continue;
+    }
+    // Each 64-bit lane is a pair of 32-bit lanes, so widen the mask
+    unsigned pairs = 0;
+    for (int lane = 0; lane < 4; lane++) {
+      if (mask & (1u << lane)) {
+        pairs |= 3u << (2 * lane);
+      }
+    }
+    const __m256i lanes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+    const __m256i packed = _mm256_permutevar8x32_epi32(
+        lanes, _mm256_load_si256(reinterpret_cast<const __m256i *>(
+                   table.permutations[pairs])));
+    const int count = std::popcount(mask);
+    _mm256_maskstore_epi64(
+        reinterpret_cast<long long *>(dest + n),
+        _mm256_load_si256(
+            reinterpret_cast<const __m256i *>(table.store_masks[2 * count])),
+        packed);
+    n += count;
+  }
+  return n + ScalarCompact<sizeof(*in)>(in, bitmap, i, length, dest + n);
+}
+
+__attribute__((target("avx2"))) int64_t
+Avx2FindFirstError(const Status *statuses, int64_t length) {
+  const auto *states = reinterpret_cast<const unsigned char *>(statuses);
+  int64_t i = 0;
+  for (; i + 4 <= length; i += 4) {
+    const __m256i pointers = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(states + i * sizeof(Status)));
+    const int ok = _mm256_movemask_pd(_mm256_castsi256_pd(
+        _mm256_cmpeq_epi64(pointers, _mm256_setzero_si256())));
+    if (ok != 0xF) {
+      return i + std::countr_zero(static_cast<unsigned>(~ok));
+    }
+  }
+  return ScalarFindFirstError(statuses, i, length);
+}
+
+// AVX-512
+
+#define FUTURES_AVX512_TARGET                                                  \
+  __attribute__((target("avx512f,avx512bw,avx512vl")))
+
+FUTURES_AVX512_TARGET int64_t Avx512FindFirstUnset(const uint64_t *bitmap,
+                                                   int64_t length) {
+  const int64_t full_words = length / 64;
+  const __m512i ones = _mm512_set1_epi64(-1);
+  int64_t w = 0;
+  for (; w + 8 <= full_words; w += 8) {
+    const __mmask8 not_all_set =
+        _mm512_cmpneq_epi64_mask(_mm512_loadu_si512(bitmap + w), ones);
+    if (not_all_set != 0) {
+      const int64_t lane = std::countr_zero(static_cast<unsigned>(not_all_set));
+      return (w + lane) * 64 + std::countr_zero(~bitmap[w + lane]);
+    }
+  }
+  return ScalarFindFirstUnset(bitmap, w, length);
+}
+
+FUTURES_AVX512_TARGET int64_t Avx512CompactSet32(const void *values,
+                                                 const uint64_t *bitmap,
+                                                 int64_t length, void *out) {
+  const auto *in = static_cast<const int32_t *>(values);
+  auto *dest = static_cast<int32_t *>(out);
+  int64_t n = 0;
+  int64_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    const __mmask16 mask =
+        static_cast<__mmask16>((bitmap[i / 64] >> (i % 64)) & 0xFFFF);
+    // Compressing in a register then doing a masked store is much faster
+    // than a compressing store on some CPUs
+    const __m512i packed =
+        _mm512_maskz_compress_epi32(mask, _mm512_loadu_si512(in + i));
+    const int count = std::popcount(static_cast<unsigned>(mask));
+    _mm512_mask_storeu_epi32(dest + n,
+                             static_cast<__mmask16>((1u << count) - 1), packed);
+    n += count;
+  }
+  return n + ScalarCompact<sizeof(*in)>(in, bitmap, i, length, dest + n);
+}
+
+FUTURES_AVX512_TARGET int64_t Avx512CompactSet64(const void *values,
+                                                 const uint64_t *bitmap,
+                                                 int64_t length, void *out) {
+  const auto *in = static_cast<const int64_t *>(values);
+  auto *dest = static_cast<int64_t *>(out);
+  int64_t n = 0;
+  int64_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    const __mmask8 mask =
+        static_cast<__mmask8>((bitmap[i / 64] >> (i % 64)) & 0xFF);
+    const __m512i packed =
+        _mm512_maskz_compress_epi64(mask, _mm512_loadu_si512(in + i));
+    const int count = std::popcount(static_cast<unsigned>(mask));
+    _mm512_mask_storeu_epi64(dest + n, static_cast<__mmask8>((1u << count) - 1),
+                             packed);
+    n += count;
+  }
+  return n + ScalarCompact<sizeof(*in)>(in, bitmap, i, length, dest + n);
+}
+
+FUTURES_AVX512_TARGET int64_t Avx512FindFirstError(const Status *statuses,
+                                                   int64_t length) {
+  const auto *states = reinterpret_cast<const unsigned char *>(statuses);
+  int64_t i = 0;
+  for (; i + 8 <= length; i += 8) {
+    const __m512i pointers = _mm512_loadu_si512(states + i * sizeof(Status));
+    const __mmask8 errors = _mm512_test_epi64_mask(pointers, pointers);
+    if (errors != 0) {
+      return i + std::countr_zero(static_cast<unsigned>(errors));
+    }
+  }
+  return ScalarFindFirstError(statuses, i, length);
+}
+
+#endif // FUTURES_HAVE_X86_KERNELS
+
+SimdLevel DetectSimdLevelOnce() {
+#ifdef FUTURES_HAVE_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+      __builtin_cpu_supports("avx512vl")) {
+    return SimdLevel::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return SimdLevel::AVX2;
+  }
+#endif
+  return SimdLevel::Scalar;
+}
+
+std::atomic<SimdLevel> &CurrentSimdLevel() {
+  static std::atomic<SimdLevel> level{DetectSimdLevel()};
+  return level;
+}
+
+} // namespace
+
+SimdLevel DetectSimdLevel() {
+  static const SimdLevel level = DetectSimdLevelOnce();
+  return level;
+}
+
+SimdLevel GetSimdLevel() {
+  return CurrentSimdLevel().load(std::memory_order_relaxed);
+}
+
+void SetSimdLevel(SimdLevel level) {
+  CurrentSimdLevel().store(std::min(level, DetectSimdLevel()),
+                           std::memory_order_relaxed);
+}
+
+namespace kernels {
+
+int64_t FindFirstUnset(const uint64_t *bitmap, int64_t length) {
+#ifdef FUTURES_HAVE_X86_KERNELS
+  switch (GetSimdLevel()) {
+  case SimdLevel::AVX512:
+    return Avx512FindFirstUnset(bitmap, length);
+  case SimdLevel::AVX2:
+    return Avx2FindFirstUnset(bitmap, length);
+  default:
+    break;
+  }
+#endif
+  return ScalarFindFirstUnset(bitmap, 0, length);
+}
+
+int64_t CountSet(const uint64_t *bitmap, int64_t length) {
+#ifdef FUTURES_HAVE_X86_KERNELS
+  // Without VPOPCNTQ the AVX2 lookup is as good as it gets
+  if (GetSimdLevel() >= SimdLevel::AVX2) {
+    return Avx2CountSet(bitmap, length);
+  }
+#endif
+  return ScalarCountSet(bitmap, 0, length);
+}
+
+int64_t CompactSet32(const void *values, const uint64_t *bitmap,
+                     int64_t length, void *out) {
+#ifdef FUTURES_HAVE_X86_KERNELS
+  switch (GetSimdLevel()) {
+  case SimdLevel::AVX512:
+    return Avx512CompactSet32(values, bitmap, length, out);
+  case SimdLevel::AVX2:
+    return Avx2CompactSet32(values, bitmap, length, out);
+  default:
+    break;
+  }
+#endif
+  return ScalarCompact<4>(values, bitmap, 0, length, out);
+}
+
+int64_t CompactSet64(const void *values, const uint64_t *bitmap,
+                     int64_t length, void *out) {
+#ifdef FUTURES_HAVE_X86_KERNELS
+  switch (GetSimdLevel()) {
+  case SimdLevel::AVX512:
+    return Avx512CompactSet64(values, bitmap, length, out);
+  case SimdLevel::AVX2:
+    return Avx2CompactSet64(values, bitmap, length, out);
+  default:
+    break;
+  }
+#endif
+  return ScalarCompact<8>(values, bitmap, 0, length, out);
+}
+
+int64_t FindFirstError(const Status *statuses, int64_t length) {
+#ifdef FUTURES_HAVE_X86_KERNELS
+  switch (GetSimdLevel()) {
+  case SimdLevel::AVX512:
+    return Avx512FindFirstError(statuses, length);
+  case SimdLevel::AVX2:
+    return Avx2FindFirstError(statuses, length);
+  default:
+    break;
+  }
+#endif
+  return ScalarFindFirstError(statuses, 0, length);
+}
+
+} // namespace kernels
+
+} // namespace futures
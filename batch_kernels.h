@@ -0,0 +1,114 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "result_batch.h"
+#include "status.h"
+
+namespace futures {
+
+/// \brief Instruction sets the batch kernels can use
+enum class SimdLevel : char { Scalar = 0, AVX2 = 1, AVX512 = 2 };
+
+/// \brief The best level this CPU supports
+SimdLevel DetectSimdLevel();
+
+/// \brief The level the kernels currently use, DetectSimdLevel() unless
+/// lowered with SetSimdLevel
+SimdLevel GetSimdLevel();
+
+/// \brief Use at most `level` from now on, e.g. to compare against the scalar
+/// kernels.  Levels the CPU doesn't support are ignored.  Not thread safe with
+/// respect to running kernels.
+void SetSimdLevel(SimdLevel level);
+
+namespace kernels {
+
+// Bitmaps follow ResultBatch: bit i of word i / 64, bits past `length` clear.
+
+/// \brief The index of the first clear bit, or -1 if all `length` are set
+int64_t FindFirstUnset(const uint64_t *bitmap, int64_t length);
+
+int64_t CountSet(const uint64_t *bitmap, int64_t length);
+
+/// \brief Copy the 4-byte values whose bits are set to the front of `out`,
+/// returning how many were copied.  `out` needs room for CountSet of them.
+int64_t CompactSet32(const void *values, const uint64_t *bitmap,
+                     int64_t length, void *out);
+
+/// \brief CompactSet32 for 8-byte values
+int64_t CompactSet64(const void *values, const uint64_t *bitmap,
+                     int64_t length, void *out);
+
+/// \brief The index of the first status that is not OK, or -1
+int64_t FindFirstError(const Status *statuses, int64_t length);
+
+} // namespace kernels
+
+/// \brief The index of the first error in the batch, or -1
+template <typename T> int64_t FindFirstError(const ResultBatch<T> &batch) {
+  return kernels::FindFirstUnset(batch.validity_bitmap().data(), batch.size());
+}
+
+template <typename T> int64_t CountOk(const ResultBatch<T> &batch) {
+  return kernels::CountSet(batch.validity_bitmap().data(), batch.size());
+}
+
+/// \brief Copy the OK values of the batch to the front of `out`, which needs
+/// room for CountOk(batch) of them, returning how many were copied
+template <typename T> int64_t CompactOk(const ResultBatch<T> &batch, T *out) {
+  if constexpr (std::is_trivially_copyable_v<T> && sizeof(T) == 4) {
+    return kernels::CompactSet32(batch.values().data(),
+                                 batch.validity_bitmap().data(), batch.size(),
+                                 out);
+  } else if constexpr (std::is_trivially_copyable_v<T> && sizeof(T) == 8) {
+    return kernels::CompactSet64(batch.values().data(),
+                                 batch.validity_bitmap().data(), batch.size(),
+                                 out);
+  } else {
+    int64_t n = 0;
+    for (int64_t i = 0; i < batch.size(); i++) {
+      if (batch.IsOk(i)) {
+        out[n++] = batch.value(i);
+      }
+    }
+    return n;
+  }
+}
+
+/// \brief The OK values of the batch, densely packed
+template <typename T> std::vector<T> CompactOk(const ResultBatch<T> &batch) {
+  std::vector<T> out(CountOk(batch));
+  CompactOk(batch, out.data());
+  return out;
+}
+
+/// \brief The first error among `statuses`, or OK, the same as folding them
+/// together with operator&
+inline Status AggregateStatuses(std::span<const Status> statuses) {
+  const int64_t first = kernels::FindFirstError(
+      statuses.data(), static_cast<int64_t>(statuses.size()));
+  return first < 0 ? Status::OK() : statuses[first];
+}
+
+} // namespace futures
@@ -0,0 +1,83 @@
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "batch_kernels.h"
+#include "result_batch.h"
+
+namespace futures {
+
+// Runs the body once per SIMD level this CPU supports
+class BatchKernelsTest : public ::testing::TestWithParam<SimdLevel> {
+protected:
+  void SetUp() override {
+    if (GetParam() > DetectSimdLevel()) {
+      GTEST_SKIP() << "not supported on this CPU";
+    }
+    SetSimdLevel(GetParam());
+  }
+  void TearDown() override { SetSimdLevel(SimdLevel::AVX512); }
+};
+
+template <typename T>
+ResultBatch<T> RandomBatch(int64_t length, double error_rate, uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  std::bernoulli_distribution is_error(error_rate);
+  ResultBatch<T> batch;
+  for (int64_t i = 0; i < length; i++) {
+    if (is_error(rng)) {
+      batch.AppendError(Status::Invalid("error ", i));
+    } else {
+      batch.AppendValue(static_cast<T>(i + 1));
+    }
+  }
+  return batch;
+}
+
+template <typename T> void CheckBatch(const ResultBatch<T> &batch) {
+  int64_t first_error = -1;
+  std::vector<T> ok_values;
+  for (int64_t i = 0; i < batch.size(); i++) {
+    if (batch.IsOk(i)) {
+      ok_values.push_back(batch.value(i));
+    } else if (first_error < 0) {
+      first_error = i;
+    }
+  }
+  ASSERT_EQ(first_error, FindFirstError(batch));
+  ASSERT_EQ(static_cast<int64_t>(ok_values.size()), CountOk(batch));
+  ASSERT_EQ(ok_values, CompactOk(batch));
+}
+
+TEST_P(BatchKernelsTest, MatchesScalar) {
+  for (int64_t length : {0, 1, 7, 8, 63, 64, 65, 255, 256, 1000, 4099}) {
+    for (double error_rate : {0.0, 0.001, 0.1, 0.5, 1.0}) {
+      const uint64_t seed =
+          length * 31 + static_cast<uint64_t>(error_rate * 1000);
+      CheckBatch(RandomBatch<int32_t>(length, error_rate, seed));
+      CheckBatch(RandomBatch<float>(length, error_rate, seed));
+      CheckBatch(RandomBatch<int64_t>(length, error_rate, seed));
+      CheckBatch(RandomBatch<double>(length, error_rate, seed));
+      CheckBatch(RandomBatch<int16_t>(length, error_rate, seed));
+    }
+  }
+}
+
+TEST_P(BatchKernelsTest, AggregateStatuses) {
+  for (int length : {0, 1, 3, 4, 9, 100}) {
+    std::vector<Status> statuses(length);
+    ASSERT_TRUE(AggregateStatuses(statuses).ok());
+    for (int error_at = length - 1; error_at >= 0; error_at -= 3) {
+      statuses[error_at] = Status::IOError("at ", error_at);
+      ASSERT_EQ(statuses[error_at], AggregateStatuses(statuses));
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Levels, BatchKernelsTest,
+                         ::testing::Values(SimdLevel::Scalar, SimdLevel::AVX2,
+                                           SimdLevel::AVX512));
+
+} // namespace futures
@@ -0,0 +1,400 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "future.h"
+#include "result_batch.h"
+#include "ring_buffer.h"
+
+namespace futures {
+
+struct BatchOptions {
+  /// \brief Items per batch, and the smallest batch in adaptive mode
+  int64_t batch_size = 1024;
+  /// \brief Grow batches while they wait in the executor's queue
+  bool adaptive = false;
+  /// \brief The largest batch in adaptive mode
+  int64_t max_batch_size = 64 * 1024;
+  /// \brief In adaptive mode, batches that waited longer than this to start
+  /// double the batch size and batches that waited less than a quarter of it
+  /// halve it
+  std::chrono::nanoseconds target_queue_delay = std::chrono::microseconds(100);
+  /// \brief How many batches Visit keeps in flight at once
+  int readahead = 1;
+};
+
+/// \brief Produces the items of a stream one at a time, nullopt at the end
+///
+/// An error is stored in the batch in place of an item and the stream goes
+/// on.  Calls are serialized by the stream.
+template <typename T> using BatchSource = FuncType<Result<std::optional<T>>()>;
+
+namespace internal {
+
+/// \brief The current batch size of a stream
+class BatchSizer {
+public:
+  explicit BatchSizer(const BatchOptions &options)
+      : options_(options),
+        batch_size_(std::max<int64_t>(options.batch_size, 1)) {}
+
+  int64_t batch_size() const {
+    return batch_size_.load(std::memory_order_relaxed);
+  }
+
+  const BatchOptions &options() const { return options_; }
+
+  /// \brief Adjust the batch size given how long a batch waited to start
+  void Observe(std::chrono::nanoseconds queue_delay) {
+    if (!options_.adaptive) {
+      return;
+    }
+    const int64_t min_size = std::max<int64_t>(options_.batch_size, 1);
+    const int64_t max_size = std::max(options_.max_batch_size, min_size);
+    int64_t size = batch_size();
+    if (queue_delay > options_.target_queue_delay) {
+      size = std::min(size * 2, max_size);
+    } else if (queue_delay < options_.target_queue_delay / 4) {
+      size = std::max(size / 2, min_size);
+    }
+    batch_size_.store(size, std::memory_order_relaxed);
+  }
+
+private:
+  const BatchOptions options_;
+  std::atomic<int64_t> batch_size_;
+};
+
+template <typename T> struct BatchSourceState {
+  struct Stashed {
+    // Nullopt past the end of the stream
+    std::optional<ResultBatch<T>> batch;
+    bool taken = false;
+  };
+
+  // Batches go to futures in the order Next was called, whichever runs first
+  std::atomic<int64_t> next_ticket{0};
+
+  // Guards everything below
+  std::mutex mutex;
+  BatchSource<T> source;
+  bool exhausted = false;
+  // Batches pulled by a later ticket on behalf of earlier ones that have not
+  // run yet, starting at ticket first_stashed
+  RingBuffer<Stashed> stash;
+  int64_t first_stashed = 0;
+};
+
+} // namespace internal
+
+/// \brief A stream whose futures each carry a batch of items
+///
+/// Pulling one LazyFuture per record pays for a type-erased chain, an
+/// executor spawn and a Result per record.  Here that cost is paid once per
+/// batch: each future pulls up to batch_size() items from the source and
+/// every operator added with Map or MapBatch is a single step of that future
+/// which loops over the whole batch.
+template <typename T> class BatchStream {
+public:
+  using Batch = ResultBatch<T>;
+
+  BatchStream(BatchSource<T> source, Executor *executor,
+              BatchOptions options = {})
+      : sizer_(std::make_shared<internal::BatchSizer>(options)) {
+    auto state = std::make_shared<internal::BatchSourceState<T>>();
+    state->source = std::move(source);
+    next_ = [state, sizer = sizer_, executor]() {
+      const auto created = std::chrono::steady_clock::now();
+      const int64_t ticket = state->next_ticket.fetch_add(1);
+      return LazyFuture<std::optional<Batch>>(
+          [state, sizer, created, ticket]() -> Result<std::optional<Batch>> {
+            sizer->Observe(std::chrono::steady_clock::now() - created);
+            return TakeBatch(state.get(), ticket, sizer->batch_size());
+          },
+          executor);
+    };
+  }
+
+  /// \brief A stream over the items of a vector
+  static BatchStream FromVector(std::vector<T> items, Executor *executor,
+                                BatchOptions options = {}) {
+    struct VectorSource {
+      Result<std::optional<T>> operator()() {
+        if (next == items->size()) {
+          return std::optional<T>();
+        }
+        return std::optional<T>(std::move((*items)[next++]));
+      }
+      std::shared_ptr<std::vector<T>> items;
+      size_t next;
+    };
+    return BatchStream(
+        VectorSource{std::make_shared<std::vector<T>>(std::move(items)), 0},
+        executor, options);
+  }
+
+  /// \brief A future for the next batch, nullopt once the stream has ended
+  ///
+  /// Several batches may be in flight at once.  Batches are handed out in
+  /// the order Next was called even if the futures run out of order, so
+  /// every future returned must be run.  A batch is never empty unless
+  /// MapBatch made it so.
+  LazyFuture<std::optional<Batch>> Next() const { return next_(); }
+
+  /// \brief The number of items the next batch will pull
+  int64_t batch_size() const { return sizer_->batch_size(); }
+
+  /// \brief Apply map_func to every OK item, errors are passed through
+  template <typename V> BatchStream<V> Map(OkMapTask<T, V> map_func) && {
+    auto shared = std::make_shared<OkMapTask<T, V>>(std::move(map_func));
+    return std::move(*this).template MapBatch<V>(
+        [shared](Batch batch) -> Result<ResultBatch<V>> {
+          return MapItems<V>(std::move(batch), *shared);
+        });
+  }
+
+  /// \brief Apply map_func to each batch as a whole
+  ///
+  /// An error fails the future for the batch, not just one item.
+  template <typename V>
+  BatchStream<V> MapBatch(OkMapTask<Batch, ResultBatch<V>> map_func) && {
+    auto shared =
+        std::make_shared<OkMapTask<Batch, ResultBatch<V>>>(std::move(map_func));
+    return BatchStream<V>(
+        [next = std::move(next_), shared]() {
+          return next().template ThenOk<std::optional<ResultBatch<V>>>(
+              [shared](std::optional<Batch> batch)
+                  -> Result<std::optional<ResultBatch<V>>> {
+                if (!batch) {
+                  return std::optional<ResultBatch<V>>();
+                }
+                ARROW_ASSIGN_OR_RAISE(auto mapped,
+                                      (*shared)(std::move(*batch)));
+                return std::optional<ResultBatch<V>>(std::move(mapped));
+              });
+        },
+        std::move(sizer_));
+  }
+
+  /// \brief Run every item through a synchronous Pipeline, one step per
+  /// batch
+  ///
+  /// Unlike a chain of Maps, the stages of the pipeline are fused, so there
+  /// is no indirect call per item and stage.
+  template <typename P>
+  BatchStream<typename P::OutputType> Pipe(P pipeline) && {
+    static_assert(P::kSynchronous, "Pipe needs a pipeline without futures");
+    using V = typename P::OutputType;
+    auto shared = std::make_shared<P>(std::move(pipeline));
+    return std::move(*this).template MapBatch<V>(
+        [shared](Batch batch) -> Result<ResultBatch<V>> {
+          return shared->ApplyToBatch(std::move(batch));
+        });
+  }
+
+  /// \brief Pass batches to visitor in order until the stream ends, a batch
+  /// fails or visitor returns an error
+  ///
+  /// Up to BatchOptions::readahead batches are pulled ahead of the one being
+  /// visited.  on_done receives the first error or OK.
+  void Visit(FuncType<Status(const Batch &)> visitor,
+             VoidConsumer on_done) && {
+    auto visit = std::make_shared<Visitor>();
+    visit->next = std::move(next_);
+    visit->visitor = std::move(visitor);
+    visit->on_done = std::move(on_done);
+    visit->Start(std::max(sizer_->options().readahead, 1));
+  }
+
+private:
+  template <typename> friend class BatchStream;
+
+  using NextFunc = FuncType<LazyFuture<std::optional<Batch>>()>;
+
+  BatchStream(NextFunc next, std::shared_ptr<internal::BatchSizer> sizer)
+      : next_(std::move(next)), sizer_(std::move(sizer)) {}
+
+  // Pulls batches up to and including the one for `ticket`
+  static std::optional<Batch> TakeBatch(internal::BatchSourceState<T> *state,
+                                        int64_t ticket, int64_t size) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    auto &stash = state->stash;
+    while (state->first_stashed + static_cast<int64_t>(stash.size()) <=
+           ticket) {
+      stash.push_back({PullBatch(state, size), false});
+    }
+    auto &stashed = stash[ticket - state->first_stashed];
+    std::optional<Batch> batch = std::move(stashed.batch);
+    stashed.taken = true;
+    while (!stash.empty() && stash.front().taken) {
+      stash.pop_front();
+      state->first_stashed++;
+    }
+    return batch;
+  }
+
+  static std::optional<Batch> PullBatch(internal::BatchSourceState<T> *state,
+                                        int64_t size) {
+    Batch batch;
+    if (state->exhausted) {
+      return std::nullopt;
+    }
+    batch.Reserve(size);
+    while (batch.size() < size) {
+      Result<std::optional<T>> item = state->source();
+      if (!item.ok()) {
+        batch.AppendError(item.status());
+      } else if (!item->has_value()) {
+        state->exhausted = true;
+        state->source = {};
+        if (batch.empty()) {
+          return std::nullopt;
+        }
+        break;
+      } else {
+        batch.AppendValue(std::move(**item));
+      }
+    }
+    return batch;
+  }
+
+  template <typename V>
+  static ResultBatch<V> MapItems(Batch batch, OkMapTask<T, V> &map_func) {
+    ResultBatch<V> mapped;
+    mapped.Reserve(batch.size());
+    auto errors = batch.errors();
+    auto values = batch.mutable_values();
+    size_t next_error = 0;
+    for (int64_t i = 0; i < batch.size(); i++) {
+      if (next_error < errors.size() && errors[next_error].first == i) {
+        mapped.AppendError(errors[next_error++].second);
+      } else {
+        mapped.Append(map_func(std::move(values[i])));
+      }
+    }
+    return mapped;
+  }
+
+  // Keeps batches in flight and visits them in the order they were pulled.
+  // Whoever fills in the oldest pending batch delivers it and any ready ones
+  // behind it, pulling a replacement for each.  A batch that completes while
+  // another call is delivering (including inline, from that call's own pull)
+  // is only stored, so delivery never recurses.
+  struct Visitor : std::enable_shared_from_this<Visitor> {
+    using Pending = std::optional<Result<std::optional<Batch>>>;
+
+    void Start(int readahead) {
+      for (int i = 0; i < readahead; i++) {
+        Pull();
+      }
+    }
+
+    void Pull() {
+      int64_t sequence;
+      std::optional<LazyFuture<std::optional<Batch>>> future;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (finished) {
+          return;
+        }
+        sequence = first_pending + static_cast<int64_t>(pending.size());
+        pending.emplace_back();
+        // next() takes the source's ticket, which must be taken in the same
+        // order as the sequence numbers.  It only builds a lazy future so it
+        // is cheap to call under the lock.
+        future.emplace(next());
+      }
+      std::move(*future).ConsumeAsync(
+          [self = this->shared_from_this(),
+           sequence](Result<std::optional<Batch>> batch) {
+            self->OnArrival(sequence, std::move(batch));
+          });
+    }
+
+    void OnArrival(int64_t sequence, Result<std::optional<Batch>> batch) {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (finished) {
+        return;
+      }
+      pending[sequence - first_pending] = std::move(batch);
+      if (delivering) {
+        return;
+      }
+      delivering = true;
+      while (!finished && !pending.empty() && pending.front().has_value()) {
+        Result<std::optional<Batch>> ready = std::move(*pending.front());
+        pending.pop_front();
+        first_pending++;
+        lock.unlock();
+        const bool more = OnBatch(std::move(ready));
+        if (more) {
+          Pull();
+        }
+        lock.lock();
+        if (!more) {
+          finished = true;
+          pending.clear();
+        }
+      }
+      delivering = false;
+    }
+
+    // Returns false once on_done has been called
+    bool OnBatch(Result<std::optional<Batch>> batch) {
+      Status status = batch.status();
+      if (status.ok()) {
+        if (!batch->has_value()) {
+          std::move(on_done)(Status::OK());
+          return false;
+        }
+        status = visitor(**batch);
+      }
+      if (!status.ok()) {
+        std::move(on_done)(std::move(status));
+        return false;
+      }
+      return true;
+    }
+
+    NextFunc next;
+    FuncType<Status(const Batch &)> visitor;
+    VoidConsumer on_done;
+
+    std::mutex mutex;
+    // One entry per batch in flight, oldest first, filled in as they arrive
+    RingBuffer<Pending> pending;
+    int64_t first_pending = 0;
+    bool delivering = false;
+    bool finished = false;
+  };
+
+  NextFunc next_;
+  std::shared_ptr<internal::BatchSizer> sizer_;
+};
+
+} // namespace futures
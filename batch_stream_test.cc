@@ -0,0 +1,235 @@
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "batch_stream.h"
+#include "future.h"
+
+namespace futures {
+
+// Visits every batch of `stream` and waits until it is done
+template <typename T>
+Status VisitAndWait(BatchStream<T> stream,
+                    FuncType<Status(const ResultBatch<T> &)> visitor) {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::optional<Status> done;
+  std::move(stream).Visit(std::move(visitor), [&](Status status) {
+    std::lock_guard<std::mutex> lock(mutex);
+    done = std::move(status);
+    cv.notify_one();
+  });
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&] { return done.has_value(); });
+  return *done;
+}
+
+TEST(BatchStreamTest, MapsWholeBatches) {
+  ThreadPoolExecutor executor(2);
+  std::vector<int> items(10000);
+  std::iota(items.begin(), items.end(), 0);
+  BatchOptions options;
+  options.batch_size = 256;
+  auto stream =
+      BatchStream<int>::FromVector(std::move(items), &executor, options)
+          .Map<int64_t>([](int x) -> Result<int64_t> { return x * 2; })
+          .Map<int64_t>([](int64_t x) -> Result<int64_t> { return x + 1; });
+  int64_t num_batches = 0;
+  int64_t num_items = 0;
+  int64_t sum = 0;
+  Status status = VisitAndWait<int64_t>(
+      std::move(stream), [&](const ResultBatch<int64_t> &batch) {
+        EXPECT_LE(batch.size(), 256);
+        EXPECT_EQ(0, batch.error_count());
+        num_batches++;
+        num_items += batch.size();
+        for (int64_t value : batch.values()) {
+          sum += value;
+        }
+        return Status::OK();
+      });
+  ASSERT_TRUE(status.ok()) << status.ToString();
+  ASSERT_EQ(40, num_batches);
+  ASSERT_EQ(10000, num_items);
+  ASSERT_EQ(10000LL * 10000, sum);
+}
+
+TEST(BatchStreamTest, ItemErrorsPassThrough) {
+  InlineExecutor executor;
+  int next = 0;
+  BatchSource<int> source = [&]() -> Result<std::optional<int>> {
+    if (next == 100) {
+      return std::optional<int>();
+    }
+    int item = next++;
+    if (item % 10 == 3) {
+      return Status::Invalid("bad item ", item);
+    }
+    return std::optional<int>(item);
+  };
+  BatchOptions options;
+  options.batch_size = 32;
+  int mapped = 0;
+  auto stream = BatchStream<int>(std::move(source), &executor, options)
+                    .Map<int>([&](int x) -> Result<int> {
+                      mapped++;
+                      return x;
+                    });
+  std::vector<Status> errors;
+  Status status = VisitAndWait<int>(
+      std::move(stream), [&](const ResultBatch<int> &batch) {
+        for (const auto &error : batch.errors()) {
+          errors.push_back(error.second);
+        }
+        return Status::OK();
+      });
+  ASSERT_TRUE(status.ok()) << status.ToString();
+  ASSERT_EQ(90, mapped);
+  ASSERT_EQ(10, errors.size());
+  ASSERT_EQ("bad item 3", errors[0].message());
+  ASSERT_EQ("bad item 93", errors[9].message());
+}
+
+TEST(BatchStreamTest, BatchErrorEndsVisit) {
+  InlineExecutor executor;
+  std::vector<int> items(1000, 1);
+  BatchOptions options;
+  options.batch_size = 100;
+  int batches_mapped = 0;
+  auto stream =
+      BatchStream<int>::FromVector(std::move(items), &executor, options)
+          .MapBatch<int>(
+              [&](ResultBatch<int> batch) -> Result<ResultBatch<int>> {
+                if (++batches_mapped == 3) {
+                  return Status::IOError("lost batch");
+                }
+                return batch;
+              });
+  int visited = 0;
+  Status status =
+      VisitAndWait<int>(std::move(stream), [&](const ResultBatch<int> &) {
+        visited++;
+        return Status::OK();
+      });
+  ASSERT_TRUE(status.IsIOError());
+  ASSERT_EQ(2, visited);
+  ASSERT_EQ(3, batches_mapped);
+}
+
+TEST(BatchStreamTest, InlineVisitDoesNotRecurse) {
+  // One item per batch, a recursive visit would overflow the stack
+  InlineExecutor executor;
+  BatchOptions options;
+  options.batch_size = 1;
+  auto stream = BatchStream<int>::FromVector(std::vector<int>(200000, 1),
+                                             &executor, options);
+  int64_t sum = 0;
+  Status status =
+      VisitAndWait<int>(std::move(stream), [&](const ResultBatch<int> &batch) {
+        sum += batch.value(0);
+        return Status::OK();
+      });
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(200000, sum);
+}
+
+TEST(BatchStreamTest, ReadaheadKeepsOrder) {
+  ThreadPoolExecutor executor(4);
+  std::vector<int> items(20000);
+  std::iota(items.begin(), items.end(), 0);
+  BatchOptions options;
+  options.batch_size = 100;
+  options.readahead = 8;
+  auto stream =
+      BatchStream<int>::FromVector(std::move(items), &executor, options)
+          .Map<int>([](int x) -> Result<int> {
+            // Uneven work so that batches finish out of order
+            if (x % 700 == 0) {
+              std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            return x;
+          });
+  int expected = 0;
+  Status status =
+      VisitAndWait<int>(std::move(stream), [&](const ResultBatch<int> &batch) {
+        for (int value : batch.values()) {
+          EXPECT_EQ(expected++, value);
+        }
+        return Status::OK();
+      });
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(20000, expected);
+}
+
+TEST(BatchStreamTest, DeepReadaheadKeepsOrder) {
+  // Many single-item batches in flight at once, so the starting pulls race
+  // with the pulls made by workers delivering batches
+  constexpr int kNumItems = 4000;
+  for (int run = 0; run < 20; run++) {
+    ThreadPoolExecutor executor(4);
+    std::vector<int> items(kNumItems);
+    std::iota(items.begin(), items.end(), 0);
+    BatchOptions options;
+    options.batch_size = 1;
+    options.readahead = 256;
+    auto stream =
+        BatchStream<int>::FromVector(std::move(items), &executor, options);
+    int expected = 0;
+    Status status = VisitAndWait<int>(
+        std::move(stream), [&](const ResultBatch<int> &batch) {
+          for (int value : batch.values()) {
+            EXPECT_EQ(expected++, value);
+          }
+          return Status::OK();
+        });
+    ASSERT_TRUE(status.ok());
+    ASSERT_EQ(kNumItems, expected);
+  }
+}
+
+TEST(BatchStreamTest, AdaptiveBatchesGrowUnderLoad) {
+  ThreadPoolExecutor executor(1);
+  BatchOptions options;
+  options.batch_size = 16;
+  options.max_batch_size = 64;
+  options.adaptive = true;
+  options.target_queue_delay = std::chrono::milliseconds(1);
+  auto stream = BatchStream<int>::FromVector(std::vector<int>(100000, 1),
+                                             &executor, options);
+
+  // Pull one batch, with the executor's only worker busy for `busy` first
+  auto pull = [&](std::chrono::milliseconds busy) {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::optional<int64_t> size;
+    if (busy.count() > 0) {
+      executor.Spawn([busy] { std::this_thread::sleep_for(busy); });
+    }
+    stream.Next().ConsumeAsync(
+        [&](Result<std::optional<ResultBatch<int>>> batch) {
+          std::lock_guard<std::mutex> lock(mutex);
+          size = (*batch)->size();
+          cv.notify_one();
+        });
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] { return size.has_value(); });
+    return *size;
+  };
+
+  ASSERT_EQ(16, stream.batch_size());
+  ASSERT_EQ(32, pull(std::chrono::milliseconds(20)));
+  ASSERT_EQ(64, pull(std::chrono::milliseconds(20)));
+  ASSERT_EQ(64, pull(std::chrono::milliseconds(20)));
+  ASSERT_EQ(32, pull(std::chrono::milliseconds(0)));
+  ASSERT_EQ(16, pull(std::chrono::milliseconds(0)));
+  ASSERT_EQ(16, pull(std::chrono::milliseconds(0)));
+}
+
+} // namespace futures
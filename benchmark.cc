@@ -1,8 +1,17 @@
 #include <benchmark/benchmark.h>
 
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
 #include <thread>
+#include <vector>
 
+#include "batch_stream.h"
 #include "future.h"
+#include "perf_counters.h"
+#include "pipeline.h"
 
 constexpr int kNumThreads = 16;
 
@@ -19,6 +28,7 @@ void DirectCallMarkFinished(Result<internal::Empty> result) {
 
 static void BM_LazyFutureCallbackEmpty(benchmark::State &state) {
   InlineExecutor executor;
+  ScopedPerfCounters counters(state);
   for (auto _ : state) {
     LazyFuture<void> future([] { return Status::OK(); }, &executor);
     std::move(future).ConsumeAsync([](Status status) { Callback(status); });
@@ -27,6 +37,7 @@ static void BM_LazyFutureCallbackEmpty(benchmark::State &state) {
 BENCHMARK(BM_LazyFutureCallbackEmpty)->Threads(kNumThreads);
 
 static void BM_DirectCallEmpty(benchmark::State &state) {
+  ScopedPerfCounters counters(state);
   for (auto _ : state) {
     auto res = internal::Empty::ToResult(Status::OK());
     DirectCallMarkFinished(std::move(res));
@@ -41,6 +52,7 @@ void CallbackSharedPtr(std::shared_ptr<int> foo) {
 
 static void BM_LazyFutureCallbackSharedPtr(benchmark::State &state) {
   InlineExecutor executor;
+  ScopedPerfCounters counters(state);
   for (auto _ : state) {
     Supplier<std::shared_ptr<int>> supplier =
         []() -> Result<std::shared_ptr<int>> {
@@ -54,6 +66,7 @@ static void BM_LazyFutureCallbackSharedPtr(benchmark::State &state) {
 BENCHMARK(BM_LazyFutureCallbackSharedPtr)->Threads(kNumThreads);
 
 static void BM_DirectCallSharedPtr(benchmark::State &state) {
+  ScopedPerfCounters counters(state);
   for (auto _ : state) {
     Result<std::shared_ptr<int>> res = std::make_shared<int>(0);
     CallbackSharedPtr(std::move(res).MoveValueUnsafe());
@@ -63,6 +76,7 @@ BENCHMARK(BM_DirectCallSharedPtr)->Threads(kNumThreads);
 
 static void BM_LazyFutureThenSharedPtr(benchmark::State &state) {
   InlineExecutor executor;
+  ScopedPerfCounters counters(state);
   for (auto _ : state) {
     Supplier<std::shared_ptr<int>> supplier =
         []() -> Result<std::shared_ptr<int>> {
@@ -77,6 +91,246 @@ static void BM_LazyFutureThenSharedPtr(benchmark::State &state) {
 }
 BENCHMARK(BM_LazyFutureThenSharedPtr)->Threads(kNumThreads);
 
+static void BM_LazyFutureThreadPoolSharedPtr(benchmark::State &state) {
+  ThreadPoolExecutor executor(1);
+  std::atomic<int64_t> completed{0};
+  int64_t spawned = 0;
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    Supplier<std::shared_ptr<int>> supplier =
+        []() -> Result<std::shared_ptr<int>> {
+      return std::make_shared<int>(0);
+    };
+    LazyFuture<std::shared_ptr<int>> future(std::move(supplier), &executor);
+    std::move(future).ConsumeAsync([&](Result<std::shared_ptr<int>> res) {
+      CallbackSharedPtr(*res);
+      completed.fetch_add(1, std::memory_order_release);
+    });
+    spawned++;
+  }
+  while (completed.load(std::memory_order_acquire) < spawned) {
+    std::this_thread::yield();
+  }
+}
+BENCHMARK(BM_LazyFutureThreadPoolSharedPtr);
+
+// A large record that is expensive to move, passed along a chain of steps
+// that each derive a new one from the last
+struct Aggregate {
+  Aggregate() = default;
+  Aggregate(const Aggregate &previous, int64_t step)
+      : key(previous.key), sums(previous.sums) {
+    sums[step % sums.size()] += step;
+  }
+
+  std::string key = "a key too long for the small string buffer";
+  std::array<int64_t, 64> sums{};
+};
+
+constexpr int kAggregateSteps = 6;
+
+static void BM_LazyFutureLargeThenOk(benchmark::State &state) {
+  InlineExecutor executor;
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    LazyFuture<Aggregate> future(
+        []() -> Result<Aggregate> { return Aggregate(); }, &executor);
+    for (int64_t i = 0; i < kAggregateSteps; i++) {
+      future = std::move(future).ThenOk<Aggregate>(
+          [i](Aggregate in) -> Result<Aggregate> { return Aggregate(in, i); });
+    }
+    std::move(future).ConsumeAsync([](Result<Aggregate> res) {
+      benchmark::DoNotOptimize(res->sums.data());
+    });
+  }
+}
+BENCHMARK(BM_LazyFutureLargeThenOk);
+
+static void BM_LazyFutureLargeThenEmplace(benchmark::State &state) {
+  InlineExecutor executor;
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    LazyFuture<Aggregate> future(
+        []() -> Result<Aggregate> { return Result<Aggregate>(std::in_place); },
+        &executor);
+    for (int64_t i = 0; i < kAggregateSteps; i++) {
+      future = std::move(future).ThenEmplace<Aggregate>(
+          [i](Aggregate &&in, Emplacer<Aggregate> &out) {
+            out.Emplace(in, i);
+            return Status::OK();
+          });
+    }
+    std::move(future).ConsumeAsync([](Result<Aggregate> res) {
+      benchmark::DoNotOptimize(res->sums.data());
+    });
+  }
+}
+BENCHMARK(BM_LazyFutureLargeThenEmplace);
+
+static void BM_LazyFutureLargeThenInPlace(benchmark::State &state) {
+  InlineExecutor executor;
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    LazyFuture<Aggregate> future(
+        []() -> Result<Aggregate> { return Result<Aggregate>(std::in_place); },
+        &executor);
+    for (int64_t i = 0; i < kAggregateSteps; i++) {
+      future = std::move(future).ThenInPlace([i](Aggregate &value) {
+        value.sums[i % value.sums.size()] += i;
+        return Status::OK();
+      });
+    }
+    std::move(future).ConsumeAsync([](Result<Aggregate> res) {
+      benchmark::DoNotOptimize(res->sums.data());
+    });
+  }
+}
+BENCHMARK(BM_LazyFutureLargeThenInPlace);
+
+constexpr int64_t kStreamItems = 1 << 16;
+
+// One future per item, as a stream is processed without batching
+static void BM_StreamPerItemFutures(benchmark::State &state) {
+  ThreadPoolExecutor executor(1);
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    std::atomic<int64_t> completed{0};
+    for (int64_t i = 0; i < kStreamItems; i++) {
+      LazyFuture<int64_t> future([i]() -> Result<int64_t> { return i; },
+                                 &executor);
+      std::move(future)
+          .ThenOk<int64_t>([](int64_t x) -> Result<int64_t> { return x * 2; })
+          .ConsumeAsync([&](Result<int64_t> res) {
+            benchmark::DoNotOptimize(*res);
+            completed.fetch_add(1, std::memory_order_release);
+          });
+    }
+    while (completed.load(std::memory_order_acquire) < kStreamItems) {
+      std::this_thread::yield();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kStreamItems);
+}
+BENCHMARK(BM_StreamPerItemFutures)->UseRealTime();
+
+static void BM_BatchStream(benchmark::State &state) {
+  ThreadPoolExecutor executor(1);
+  BatchOptions options;
+  options.batch_size = state.range(0);
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    int64_t next = 0;
+    BatchSource<int64_t> source = [&]() -> Result<std::optional<int64_t>> {
+      if (next == kStreamItems) {
+        return std::optional<int64_t>();
+      }
+      return std::optional<int64_t>(next++);
+    };
+    std::atomic<bool> done{false};
+    BatchStream<int64_t>(std::move(source), &executor, options)
+        .Map<int64_t>([](int64_t x) -> Result<int64_t> { return x * 2; })
+        .Visit(
+            [](const ResultBatch<int64_t> &batch) {
+              benchmark::DoNotOptimize(batch.values().data());
+              return Status::OK();
+            },
+            [&](Status) { done.store(true, std::memory_order_release); });
+    while (!done.load(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kStreamItems);
+}
+BENCHMARK(BM_BatchStream)->RangeMultiplier(8)->Range(1, 4096)->UseRealTime();
+
+static void BM_LazyFutureThreeThens(benchmark::State &state) {
+  InlineExecutor executor;
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    LazyFuture<int64_t> future([]() -> Result<int64_t> { return 1; },
+                               &executor);
+    std::move(future)
+        .ThenOk<int64_t>([](int64_t x) -> Result<int64_t> { return x * 2; })
+        .ThenOk<int64_t>([](int64_t x) -> Result<int64_t> { return x + 1; })
+        .ThenOk<int64_t>([](int64_t x) -> Result<int64_t> { return x * 3; })
+        .ConsumeAsync(
+            [](Result<int64_t> res) { benchmark::DoNotOptimize(*res); });
+  }
+}
+BENCHMARK(BM_LazyFutureThreeThens);
+
+static void BM_LazyFutureFusedPipeline(benchmark::State &state) {
+  InlineExecutor executor;
+  auto pipeline = MakePipeline<int64_t>()
+                      .Map([](int64_t x) { return x * 2; })
+                      .Map([](int64_t x) { return x + 1; })
+                      .Map([](int64_t x) { return x * 3; });
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    LazyFuture<int64_t> future([]() -> Result<int64_t> { return 1; },
+                               &executor);
+    pipeline.Apply(std::move(future))
+        .ConsumeAsync([](Result<std::optional<int64_t>> res) {
+          benchmark::DoNotOptimize(**res);
+        });
+  }
+}
+BENCHMARK(BM_LazyFutureFusedPipeline);
+
+// Drains kStreamItems through `make_stream` on one pool thread
+template <typename MakeStream>
+void RunBatchStream(benchmark::State &state, MakeStream make_stream) {
+  ThreadPoolExecutor executor(1);
+  BatchOptions options;
+  options.batch_size = 1024;
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    std::vector<int64_t> items(kStreamItems, 1);
+    std::atomic<bool> done{false};
+    make_stream(BatchStream<int64_t>::FromVector(std::move(items), &executor,
+                                                 options))
+        .Visit(
+            [](const ResultBatch<int64_t> &batch) {
+              benchmark::DoNotOptimize(batch.values().data());
+              return Status::OK();
+            },
+            [&](Status) { done.store(true, std::memory_order_release); });
+    while (!done.load(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kStreamItems);
+}
+
+static void BM_BatchStreamThreeMaps(benchmark::State &state) {
+  RunBatchStream(state, [](BatchStream<int64_t> stream) {
+    return std::move(stream)
+        .Map<int64_t>([](int64_t x) -> Result<int64_t> { return x * 2; })
+        .Map<int64_t>([](int64_t x) -> Result<int64_t> { return x + 1; })
+        .Map<int64_t>([](int64_t x) -> Result<int64_t> { return x * 3; });
+  });
+}
+BENCHMARK(BM_BatchStreamThreeMaps)->UseRealTime();
+
+static void BM_BatchStreamFusedPipeline(benchmark::State &state) {
+  RunBatchStream(state, [](BatchStream<int64_t> stream) {
+    return std::move(stream).Pipe(MakePipeline<int64_t>()
+                                      .Map([](int64_t x) { return x * 2; })
+                                      .Map([](int64_t x) { return x + 1; })
+                                      .Map([](int64_t x) { return x * 3; }));
+  });
+}
+BENCHMARK(BM_BatchStreamFusedPipeline)->UseRealTime();
+
 } // namespace futures
 
-BENCHMARK_MAIN();
+int main(int argc, char **argv) {
+  futures::ParsePerfCountersFlag(&argc, argv);
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
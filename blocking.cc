@@ -0,0 +1,100 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "blocking.h"
+
+#include <thread>
+
+namespace futures {
+
+namespace {
+
+// Blocking tasks mostly wait so there can be far more of them than cores
+constexpr int kMaxBlockingThreads = 256;
+
+} // namespace
+
+ElasticThreadPool::ElasticThreadPool(int max_threads,
+                                     std::chrono::milliseconds idle_timeout)
+    : max_threads_(max_threads), idle_timeout_(idle_timeout) {}
+
+ElasticThreadPool::~ElasticThreadPool() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  stopping_ = true;
+  tasks_available_.notify_all();
+  threads_exited_.wait(lock, [this] { return num_threads_ == 0; });
+}
+
+void ElasticThreadPool::Spawn(Task task) {
+  bool start_thread = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+    if (static_cast<int>(tasks_.size()) > idle_threads_ &&
+        num_threads_ < max_threads_) {
+      num_threads_++;
+      start_thread = true;
+    }
+  }
+  if (start_thread) {
+    // Threads come and go so they are detached, the destructor waits for
+    // num_threads_ to reach zero instead of joining
+    std::thread([this] { WorkerLoop(); }).detach();
+  } else {
+    tasks_available_.notify_one();
+  }
+}
+
+int ElasticThreadPool::num_threads() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_threads_;
+}
+
+void ElasticThreadPool::WorkerLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    if (tasks_.empty() && !stopping_) {
+      idle_threads_++;
+      bool woken = tasks_available_.wait_for(
+          lock, idle_timeout_,
+          [this] { return !tasks_.empty() || stopping_; });
+      idle_threads_--;
+      if (!woken) {
+        break;
+      }
+    }
+    if (tasks_.empty()) {
+      break;
+    }
+    Task task = std::move(tasks_.front());
+    tasks_.pop_front();
+    lock.unlock();
+    std::move(task)();
+    task = nullptr;
+    lock.lock();
+  }
+  if (--num_threads_ == 0) {
+    threads_exited_.notify_all();
+  }
+}
+
+ElasticThreadPool *GetBlockingExecutor() {
+  static ElasticThreadPool pool(kMaxBlockingThreads);
+  return &pool;
+}
+
+} // namespace futures
@@ -0,0 +1,85 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+#include "future.h"
+#include "result.h"
+#include "ring_buffer.h"
+#include "status.h"
+
+namespace futures {
+
+/// \brief A thread pool that grows on demand and shrinks when idle
+///
+/// A new thread is started whenever a task is spawned and no thread is free
+/// to take it, up to max_threads.  Threads exit after sitting idle for
+/// idle_timeout.  Meant for blocking calls (syscalls, third party libraries)
+/// that would otherwise stall a fixed-size compute pool.
+///
+/// Queued tasks are drained before the destructor returns.
+class ElasticThreadPool : public Executor {
+public:
+  explicit ElasticThreadPool(
+      int max_threads,
+      std::chrono::milliseconds idle_timeout = std::chrono::seconds(10));
+  virtual ~ElasticThreadPool();
+
+  void Spawn(Task task) override;
+
+  int num_threads();
+
+private:
+  void WorkerLoop();
+
+  const int max_threads_;
+  const std::chrono::milliseconds idle_timeout_;
+  std::mutex mutex_;
+  std::condition_variable tasks_available_;
+  std::condition_variable threads_exited_;
+  RingBuffer<Task> tasks_;
+  int num_threads_ = 0;
+  int idle_threads_ = 0;
+  bool stopping_ = false;
+};
+
+/// \brief The process-wide pool used by RunBlocking
+ElasticThreadPool *GetBlockingExecutor();
+
+/// \brief Create a future that runs a blocking function off the compute pool
+///
+/// `fn` must return a Status or a Result.  It, and any continuations chained
+/// onto the returned future, run on `executor` (by default the shared
+/// ElasticThreadPool) instead of the executor of the caller.
+template <typename Fn>
+auto RunBlocking(Fn fn, Executor *executor = GetBlockingExecutor()) {
+  using Return = std::invoke_result_t<Fn &>;
+  if constexpr (std::is_same<Return, Status>::value) {
+    return LazyFuture<void>(VoidSupplier(std::move(fn)), executor);
+  } else {
+    using T = typename EnsureResult<Return>::type::ValueType;
+    return LazyFuture<T>(Supplier<T>(std::move(fn)), executor);
+  }
+}
+
+} // namespace futures
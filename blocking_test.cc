@@ -0,0 +1,81 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+#include "blocking.h"
+#include "future.h"
+
+namespace futures {
+
+TEST(BlockingTest, RunBlocking) {
+  std::thread::id main_thread_id = std::this_thread::get_id();
+  bool callback_ran = false;
+  {
+    ElasticThreadPool pool(4);
+    RunBlocking(
+        [&]() -> Result<int> {
+          EXPECT_NE(main_thread_id, std::this_thread::get_id());
+          return 5;
+        },
+        &pool)
+        .Then<int>([](Result<int> val) -> Result<int> { return *val + 1; })
+        .ConsumeAsync([&](Result<int> val) {
+          callback_ran = true;
+          ASSERT_EQ(6, *val);
+        });
+  }
+  ASSERT_TRUE(callback_ran);
+}
+
+TEST(BlockingTest, RunBlockingStatus) {
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool done = false;
+  Status result;
+  RunBlocking([] { return Status::IOError("fsync failed"); })
+      .ConsumeAsync([&](Status status) {
+        std::lock_guard<std::mutex> lock(mutex);
+        result = std::move(status);
+        done = true;
+        cv.notify_one();
+      });
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&] { return done; });
+  ASSERT_TRUE(result.IsIOError());
+}
+
+TEST(BlockingTest, GrowsAndShrinks) {
+  constexpr int kNumTasks = 8;
+  ElasticThreadPool pool(kNumTasks, std::chrono::milliseconds(10));
+  std::mutex mutex;
+  std::condition_variable cv;
+  int started = 0;
+  bool release = false;
+  for (int i = 0; i < kNumTasks; i++) {
+    pool.Spawn([&] {
+      std::unique_lock<std::mutex> lock(mutex);
+      started++;
+      cv.notify_all();
+      cv.wait(lock, [&] { return release; });
+    });
+  }
+  {
+    // Every task blocks so they can only all start on their own threads
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] { return started == kNumTasks; });
+    ASSERT_EQ(kNumTasks, pool.num_threads());
+    release = true;
+    cv.notify_all();
+  }
+  for (int i = 0; i < 1000 && pool.num_threads() > 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  ASSERT_EQ(0, pool.num_threads());
+}
+
+} // namespace futures
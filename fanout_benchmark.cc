@@ -0,0 +1,286 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "future.h"
+#include "load_util.h"
+
+// Models one microservice request: parse the request, fan out to K backends
+// whose responses arrive after a simulated network delay, join on all of
+// them, aggregate and format a response.
+//
+// Arguments are the executor (an index into ExecutorNames), the backend
+// latency distribution and K.  Requests are kept kConcurrency deep.
+
+namespace futures {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kConcurrency = 64;
+constexpr int kWorkers = 4;
+constexpr auto kMeanBackendLatency = std::chrono::microseconds(200);
+
+enum class LatencyDistribution { Fixed, Exponential, LogNormal };
+
+const char *DistributionName(LatencyDistribution distribution) {
+  switch (distribution) {
+  case LatencyDistribution::Fixed:
+    return "fixed";
+  case LatencyDistribution::Exponential:
+    return "exponential";
+  case LatencyDistribution::LogNormal:
+    return "lognormal";
+  }
+  return "unknown";
+}
+
+class LatencySampler {
+public:
+  explicit LatencySampler(LatencyDistribution distribution)
+      : distribution_(distribution),
+        exponential_(1.0 / static_cast<double>(kMeanBackendLatency.count())),
+        // sigma 1 gives the long tail of a real backend, mu keeps the mean
+        lognormal_(std::log(static_cast<double>(kMeanBackendLatency.count())) -
+                       0.5,
+                   1.0) {}
+
+  std::chrono::microseconds Sample() {
+    double micros;
+    switch (distribution_) {
+    case LatencyDistribution::Exponential:
+      micros = exponential_(rng_);
+      break;
+    case LatencyDistribution::LogNormal:
+      micros = lognormal_(rng_);
+      break;
+    default:
+      micros = static_cast<double>(kMeanBackendLatency.count());
+      break;
+    }
+    return std::chrono::microseconds(static_cast<int64_t>(micros));
+  }
+
+private:
+  LatencyDistribution distribution_;
+  std::mt19937_64 rng_{42};
+  std::exponential_distribution<double> exponential_;
+  std::lognormal_distribution<double> lognormal_;
+};
+
+// Stands in for the network, runs each callback once its delay has passed
+class SimulatedBackend {
+public:
+  SimulatedBackend() : thread_([this] { Run(); }) {}
+
+  ~SimulatedBackend() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+  }
+
+  void Call(std::chrono::microseconds delay, std::function<void()> respond) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.push({Clock::now() + delay, std::move(respond)});
+    cv_.notify_one();
+  }
+
+private:
+  struct PendingCall {
+    Clock::time_point due;
+    std::function<void()> respond;
+    bool operator<(const PendingCall &other) const { return due > other.due; }
+  };
+
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      if (pending_.empty()) {
+        if (stopping_) {
+          return;
+        }
+        cv_.wait(lock);
+        continue;
+      }
+      const auto due = pending_.top().due;
+      if (Clock::now() < due) {
+        cv_.wait_until(lock, due);
+        continue;
+      }
+      // top() is const but the entry is popped straight away
+      auto respond =
+          std::move(const_cast<PendingCall &>(pending_.top()).respond);
+      pending_.pop();
+      lock.unlock();
+      respond();
+      lock.lock();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::priority_queue<PendingCall> pending_;
+  bool stopping_ = false;
+  std::thread thread_;
+};
+
+constexpr std::string_view kRequestBody = "17,4,99,1024,3,58,7,65536,12,8";
+
+Result<int64_t> ParseRequest(std::string_view body) {
+  int64_t sum = 0;
+  while (!body.empty()) {
+    int64_t value = 0;
+    auto [end, error] =
+        std::from_chars(body.data(), body.data() + body.size(), value);
+    if (error != std::errc()) {
+      return Status::Invalid("Malformed request");
+    }
+    sum += value;
+    body.remove_prefix(end - body.data());
+    if (!body.empty()) {
+      body.remove_prefix(1);
+    }
+  }
+  return sum;
+}
+
+std::string FormatResponse(int64_t total) {
+  char buffer[32];
+  auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer), total);
+  return std::string("{\"total\":") + std::string(buffer, end) + "}";
+}
+
+// Shared by the K backend calls of one request, the last to arrive finishes
+// the request
+struct FanIn {
+  FanIn(int fan_out, Clock::time_point start)
+      : results(fan_out), remaining(fan_out), start(start) {}
+
+  std::vector<Result<int64_t>> results;
+  std::atomic<int> remaining;
+  Clock::time_point start;
+};
+
+struct RequestContext {
+  Executor *executor;
+  SimulatedBackend *backend;
+  LatencyHistogram *latency;
+  std::atomic<int> *in_flight;
+};
+
+void FinishRequest(const RequestContext &context, FanIn *fan_in) {
+  int64_t total = 0;
+  Status status;
+  for (auto &result : fan_in->results) {
+    status &= result.status();
+    if (result.ok()) {
+      total += *result;
+    }
+  }
+  std::string response =
+      status.ok() ? FormatResponse(total) : status.ToString();
+  benchmark::DoNotOptimize(response);
+  context.latency->Record(Clock::now() - fan_in->start);
+  context.in_flight->fetch_sub(1, std::memory_order_release);
+}
+
+void StartRequest(const RequestContext &context,
+                  std::vector<std::chrono::microseconds> delays) {
+  const auto start = Clock::now();
+  LazyFuture<int64_t>([] { return ParseRequest(kRequestBody); },
+                      context.executor)
+      .ConsumeAsync([context, start,
+                     delays = std::move(delays)](Result<int64_t> parsed) {
+        const int fan_out = static_cast<int>(delays.size());
+        auto fan_in = std::make_shared<FanIn>(fan_out, start);
+        for (int k = 0; k < fan_out; k++) {
+          const int64_t request = parsed.ok() ? *parsed + k : 0;
+          context.backend->Call(delays[k], [context, fan_in, k, request] {
+            // The response is handled on the executor like a real RPC
+            // completion would be
+            LazyFuture<int64_t>([request]() -> Result<int64_t> {
+              return request * 2;
+            }, context.executor)
+                .ConsumeAsync([context, fan_in, k](Result<int64_t> response) {
+                  fan_in->results[k] = std::move(response);
+                  if (fan_in->remaining.fetch_sub(
+                          1, std::memory_order_acq_rel) == 1) {
+                    FinishRequest(context, fan_in.get());
+                  }
+                });
+          });
+        }
+      });
+}
+
+} // namespace
+
+static void BM_FanOutFanIn(benchmark::State &state) {
+  const std::string executor_name = ExecutorNames()[state.range(0)];
+  const auto distribution = static_cast<LatencyDistribution>(state.range(1));
+  const int fan_out = static_cast<int>(state.range(2));
+  auto executor = MakeExecutor(executor_name, kWorkers).ValueOrDie();
+  SimulatedBackend backend;
+  LatencyHistogram latency;
+  LatencySampler sampler(distribution);
+  std::atomic<int> in_flight{0};
+  RequestContext context{executor.get(), &backend, &latency, &in_flight};
+
+  for (auto _ : state) {
+    while (in_flight.load(std::memory_order_acquire) >= kConcurrency) {
+      std::this_thread::yield();
+    }
+    std::vector<std::chrono::microseconds> delays(fan_out);
+    for (auto &delay : delays) {
+      delay = sampler.Sample();
+    }
+    in_flight.fetch_add(1, std::memory_order_relaxed);
+    StartRequest(context, std::move(delays));
+  }
+  while (in_flight.load(std::memory_order_acquire) > 0) {
+    std::this_thread::yield();
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(executor_name + "/" + DistributionName(distribution));
+  auto micros = [](std::chrono::nanoseconds duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+  };
+  state.counters["p50_us"] = micros(latency.Percentile(50));
+  state.counters["p99_us"] = micros(latency.Percentile(99));
+  state.counters["p999_us"] = micros(latency.Percentile(99.9));
+  state.counters["max_us"] = micros(latency.Max());
+}
+BENCHMARK(BM_FanOutFanIn)
+    ->ArgsProduct({benchmark::CreateDenseRange(
+                       0, static_cast<int64_t>(ExecutorNames().size()) - 1, 1),
+                   {static_cast<int64_t>(LatencyDistribution::Fixed),
+                    static_cast<int64_t>(LatencyDistribution::Exponential),
+                    static_cast<int64_t>(LatencyDistribution::LogNormal)},
+                   {4, 16}})
+    ->ArgNames({"executor", "latency", "k"})
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+} // namespace futures
+
+BENCHMARK_MAIN();
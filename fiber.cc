@@ -0,0 +1,324 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "fiber.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#ifdef FUTURES_HAVE_FIBERS
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace futures {
+
+namespace internal {
+
+#ifdef FUTURES_HAVE_FIBERS
+
+class Fiber {
+public:
+  enum class State { kRunning, kParked, kNotified };
+
+  Fiber(FiberExecutor *executor, size_t stack_size) : executor(executor) {
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    stack_size = (stack_size + page_size - 1) / page_size * page_size;
+    mapping_size = stack_size + page_size;
+    void *mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (mapping == MAP_FAILED) {
+      DieWithMessage("Failed to allocate a fiber stack");
+    }
+    // Stacks grow down so the guard page goes at the lowest address
+    if (mprotect(mapping, page_size, PROT_NONE) != 0) {
+      DieWithMessage("Failed to protect a fiber stack guard page");
+    }
+    stack_base = static_cast<unsigned char *>(mapping);
+    stack_top = stack_base + mapping_size;
+  }
+
+  ~Fiber() { munmap(stack_base, mapping_size); }
+
+  FiberExecutor *executor;
+  unsigned char *stack_base;
+  unsigned char *stack_top;
+  size_t mapping_size;
+  // Saved stack pointer of the fiber while it is not running
+  void *sp = nullptr;
+  // Saved stack pointer of the worker that is running the fiber
+  void *return_sp = nullptr;
+  Task task;
+  std::atomic<State> state{State::kRunning};
+  bool finished = false;
+};
+
+namespace {
+
+thread_local Fiber *current_fiber = nullptr;
+
+// Default MXCSR (all exceptions masked, round to nearest) and x87 control
+// word, restored by the first switch into a fiber
+constexpr uint64_t kInitialMxcsr = 0x1F80;
+constexpr uint64_t kInitialFpuControlWord = 0x037F;
+
+// Keep at most this many idle fibers (and their stacks) around for reuse
+constexpr size_t kMaxCachedFibers = 64;
+
+} // namespace
+
+} // namespace internal
+
+} // namespace futures
+
+extern "C" {
+
+// Saves the callee-saved registers of the System V ABI on the current stack,
+// stores the stack pointer in *save_sp, then restores the registers saved on
+// load_sp and returns into that context.
+void futures_switch_fiber(void **save_sp, void *load_sp);
+// Initial return address of a new fiber, calls futures_fiber_main(r12)
+void futures_fiber_trampoline();
+
+__attribute__((used, visibility("hidden"))) [[noreturn]] void
+futures_fiber_main(futures::internal::Fiber *fiber) {
+  std::move(fiber->task)();
+  fiber->task = nullptr;
+  fiber->finished = true;
+  futures_switch_fiber(&fiber->sp, fiber->return_sp);
+  __builtin_unreachable();
+}
+
+} // extern "C"
+
+asm(R"(
+  .text
+  .globl futures_switch_fiber
+  .hidden futures_switch_fiber
+  .type futures_switch_fiber, @function
+futures_switch_fiber:
+  pushq %rbp
+  pushq %rbx
+  pushq %r15
+  pushq %r14
+  pushq %r13
+  pushq %r12
+  subq $8, %rsp
+  stmxcsr (%rsp)
+  fnstcw 4(%rsp)
+  movq %rsp, (%rdi)
+  movq %rsi, %rsp
+  ldmxcsr (%rsp)
+  fldcw 4(%rsp)
+  addq $8, %rsp
+  popq %r12
+  popq %r13
+  popq %r14
+  popq %r15
+  popq %rbx
+  popq %rbp
+  ret
+  .size futures_switch_fiber, .-futures_switch_fiber
+
+  .globl futures_fiber_trampoline
+  .hidden futures_fiber_trampoline
+  .type futures_fiber_trampoline, @function
+futures_fiber_trampoline:
+  movq %r12, %rdi
+  call futures_fiber_main
+  ud2
+  .size futures_fiber_trampoline, .-futures_fiber_trampoline
+)");
+
+namespace futures {
+
+namespace internal {
+
+namespace {
+
+// Lays out a frame on a fresh stack that futures_switch_fiber can "return"
+// into, starting the fiber in futures_fiber_trampoline
+void InitFiberStack(Fiber *fiber) {
+  auto *top = reinterpret_cast<uint64_t *>(fiber->stack_top);
+  uint64_t *sp = top - 8;
+  sp[0] = kInitialMxcsr | (kInitialFpuControlWord << 32);
+  sp[1] = reinterpret_cast<uint64_t>(fiber); // r12
+  sp[2] = 0;                                 // r13
+  sp[3] = 0;                                 // r14
+  sp[4] = 0;                                 // r15
+  sp[5] = 0;                                 // rbx
+  sp[6] = 0;                                 // rbp
+  sp[7] = reinterpret_cast<uint64_t>(&futures_fiber_trampoline);
+  fiber->sp = sp;
+}
+
+} // namespace
+
+FiberWaiter::FiberWaiter() : fiber_(current_fiber) {}
+
+void FiberWaiter::Wait() {
+  if (fiber_ == nullptr) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return notified_; });
+    return;
+  }
+  // The worker publishes the fiber as parked once it is off the stack
+  Fiber *fiber = fiber_;
+  futures_switch_fiber(&fiber->sp, fiber->return_sp);
+}
+
+void FiberWaiter::Notify() {
+  if (fiber_ == nullptr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    notified_ = true;
+    cv_.notify_one();
+    return;
+  }
+  // The waiter may return (and be destroyed) as soon as the fiber is
+  // re-enqueued so don't touch `this` afterwards
+  Fiber *fiber = fiber_;
+  if (fiber->state.exchange(Fiber::State::kNotified,
+                            std::memory_order_acq_rel) ==
+      Fiber::State::kParked) {
+    fiber->executor->Enqueue(fiber);
+  }
+}
+
+#else
+
+FiberWaiter::FiberWaiter() : fiber_(nullptr) {}
+
+void FiberWaiter::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return notified_; });
+}
+
+void FiberWaiter::Notify() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  notified_ = true;
+  cv_.notify_one();
+}
+
+#endif // FUTURES_HAVE_FIBERS
+
+} // namespace internal
+
+#ifdef FUTURES_HAVE_FIBERS
+
+using internal::Fiber;
+
+FiberExecutor::FiberExecutor(int num_threads, size_t stack_size)
+    : stack_size_(stack_size) {
+  workers_.reserve(num_threads);
+  for (int i = 0; i < num_threads; i++) {
+    workers_.emplace_back([this] { WorkerLoop(); });
+  }
+}
+
+FiberExecutor::~FiberExecutor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  fibers_ready_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+  for (Fiber *fiber : free_fibers_) {
+    delete fiber;
+  }
+}
+
+void FiberExecutor::Spawn(Task task) {
+  Fiber *fiber = AcquireFiber();
+  fiber->task = std::move(task);
+  fiber->finished = false;
+  fiber->state.store(Fiber::State::kRunning, std::memory_order_relaxed);
+  internal::InitFiberStack(fiber);
+  Enqueue(fiber);
+}
+
+void FiberExecutor::Enqueue(Fiber *fiber) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ready_.push_back(fiber);
+  }
+  fibers_ready_.notify_one();
+}
+
+Fiber *FiberExecutor::AcquireFiber() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    live_fibers_++;
+    if (!free_fibers_.empty()) {
+      Fiber *fiber = free_fibers_.back();
+      free_fibers_.pop_back();
+      return fiber;
+    }
+  }
+  return new Fiber(this, stack_size_);
+}
+
+void FiberExecutor::ReleaseFiber(Fiber *fiber) {
+  bool last_fiber;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_fibers_.size() < internal::kMaxCachedFibers) {
+      free_fibers_.push_back(fiber);
+      fiber = nullptr;
+    }
+    last_fiber = --live_fibers_ == 0 && stopping_;
+  }
+  delete fiber;
+  if (last_fiber) {
+    fibers_ready_.notify_all();
+  }
+}
+
+void FiberExecutor::WorkerLoop() {
+  while (true) {
+    Fiber *fiber;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      fibers_ready_.wait(lock, [this] {
+        return !ready_.empty() || (stopping_ && live_fibers_ == 0);
+      });
+      if (ready_.empty()) {
+        return;
+      }
+      fiber = ready_.front();
+      ready_.pop_front();
+    }
+    fiber->state.store(Fiber::State::kRunning, std::memory_order_relaxed);
+    internal::current_fiber = fiber;
+    futures_switch_fiber(&fiber->return_sp, fiber->sp);
+    internal::current_fiber = nullptr;
+    if (fiber->finished) {
+      ReleaseFiber(fiber);
+    } else if (fiber->state.exchange(Fiber::State::kParked,
+                                     std::memory_order_acq_rel) ==
+               Fiber::State::kNotified) {
+      // Notified before it finished parking
+      Enqueue(fiber);
+    }
+  }
+}
+
+#endif // FUTURES_HAVE_FIBERS
+
+} // namespace futures
@@ -0,0 +1,129 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "future.h"
+#include "result.h"
+#include "ring_buffer.h"
+#include "status.h"
+
+// The context switch is hand-written for the x86-64 System V ABI
+#if defined(__x86_64__) && defined(__linux__)
+#define FUTURES_HAVE_FIBERS 1
+#endif
+
+namespace futures {
+
+namespace internal {
+
+class Fiber;
+
+/// \brief Blocks the caller until Notify is called
+///
+/// When called from a fiber only the fiber is parked and its thread moves on
+/// to other fibers.  Anywhere else the calling thread blocks.  Notify may be
+/// called before Wait and from any thread.
+class FiberWaiter {
+public:
+  FiberWaiter();
+
+  void Wait();
+  void Notify();
+
+private:
+  Fiber *fiber_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool notified_ = false;
+};
+
+} // namespace internal
+
+#ifdef FUTURES_HAVE_FIBERS
+
+constexpr size_t kDefaultFiberStackSize = 256 * 1024;
+
+/// \brief Runs each task on its own fiber, multiplexed over a few threads
+///
+/// Tasks may call Await to wait for a LazyFuture.  Waiting parks the fiber
+/// rather than the thread so blocking-style code does not need a thread per
+/// task.  Fiber stacks have a guard page and are reused between tasks.
+///
+/// The destructor waits for every fiber, including parked ones, to finish.
+class FiberExecutor : public Executor {
+public:
+  explicit FiberExecutor(int num_threads,
+                         size_t stack_size = kDefaultFiberStackSize);
+  virtual ~FiberExecutor();
+
+  void Spawn(Task task) override;
+
+private:
+  friend class internal::FiberWaiter;
+
+  void WorkerLoop();
+  void Enqueue(internal::Fiber *fiber);
+  internal::Fiber *AcquireFiber();
+  void ReleaseFiber(internal::Fiber *fiber);
+
+  const size_t stack_size_;
+  std::mutex mutex_;
+  std::condition_variable fibers_ready_;
+  RingBuffer<internal::Fiber *> ready_;
+  std::vector<internal::Fiber *> free_fibers_;
+  int live_fibers_ = 0;
+  bool stopping_ = false;
+  std::vector<std::thread> workers_;
+};
+
+#endif // FUTURES_HAVE_FIBERS
+
+/// \brief Wait for a future to finish and return its result
+///
+/// Only parks the current fiber when called from a FiberExecutor task.
+template <typename T> Result<T> Await(LazyFuture<T> future) {
+  internal::FiberWaiter waiter;
+  std::optional<Result<T>> result;
+  std::move(future).ConsumeAsync([&](Result<T> val) {
+    result.emplace(std::move(val));
+    waiter.Notify();
+  });
+  waiter.Wait();
+  return std::move(*result);
+}
+
+inline Status Await(LazyFuture<void> future) {
+  internal::FiberWaiter waiter;
+  Status result;
+  std::move(future).ConsumeAsync([&](Status status) {
+    result = std::move(status);
+    waiter.Notify();
+  });
+  waiter.Wait();
+  return result;
+}
+
+} // namespace futures
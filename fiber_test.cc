@@ -0,0 +1,78 @@
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "fiber.h"
+#include "future.h"
+
+namespace futures {
+
+TEST(FiberTest, AwaitOffFiber) {
+  ThreadPoolExecutor executor(1);
+  Supplier<int> supplier = []() -> Result<int> { return 5; };
+  Result<int> result = Await(LazyFuture<int>(std::move(supplier), &executor));
+  ASSERT_EQ(5, *result);
+}
+
+#ifdef FUTURES_HAVE_FIBERS
+
+TEST(FiberTest, RunsTasks) {
+  std::atomic<int> count{0};
+  {
+    FiberExecutor executor(2);
+    for (int i = 0; i < 100; i++) {
+      executor.Spawn([&] { count++; });
+    }
+  }
+  ASSERT_EQ(100, count.load());
+}
+
+TEST(FiberTest, AwaitParksOnlyTheFiber) {
+  // With a single thread the awaited future can only run if Await gives up
+  // the thread while it waits
+  Result<int> result;
+  {
+    FiberExecutor executor(1);
+    LazyFuture<void> outer(
+        [&] {
+          Supplier<int> supplier = []() -> Result<int> { return 5; };
+          result = Await(LazyFuture<int>(std::move(supplier), &executor)
+                             .Then<int>([](Result<int> val) -> Result<int> {
+                               return *val + 1;
+                             }));
+          return Status::OK();
+        },
+        &executor);
+    std::move(outer).ConsumeAsync([](Status) {});
+  }
+  ASSERT_EQ(6, *result);
+}
+
+TEST(FiberTest, ManyParkedFibers) {
+  constexpr int kNumFibers = 1000;
+  std::atomic<int> sum{0};
+  {
+    ThreadPoolExecutor io_executor(4);
+    FiberExecutor executor(2);
+    for (int i = 0; i < kNumFibers; i++) {
+      executor.Spawn([&, i] {
+        Supplier<int> supplier = [i]() -> Result<int> { return i; };
+        Result<int> first =
+            Await(LazyFuture<int>(std::move(supplier), &io_executor));
+        Status second = Await(LazyFuture<void>(
+            [] { return Status::IOError("fail"); }, &io_executor));
+        if (second.IsIOError()) {
+          sum += *first;
+        }
+      });
+    }
+  }
+  ASSERT_EQ(kNumFibers * (kNumFibers - 1) / 2, sum.load());
+}
+
+#endif // FUTURES_HAVE_FIBERS
+
+} // namespace futures
@@ -19,4 +19,165 @@
 
 namespace futures {
 
-}
\ No newline at end of file
+namespace internal {
+
+namespace {
+
+inline void RunChainStep(ChainStep &step, size_t index, ChainCursor *cursor) {
+  if (cursor->error.ok()) [[likely]] {
+    if (!step.HandlesValue()) {
+      return;
+    }
+    step.OnValue(cursor->in, cursor->out, &cursor->error);
+    if (step.InPlace()) {
+      // The value stayed in `in`, now owned by this step
+      cursor->producer = index;
+      return;
+    }
+  } else {
+    if (!step.HandlesError()) {
+      return;
+    }
+    step.OnError(&cursor->error, cursor->out);
+  }
+  std::swap(cursor->in, cursor->out);
+  cursor->producer = index;
+}
+
+// Reading the clock is relatively expensive so it is only checked every few
+// steps
+constexpr size_t kStepsPerClockCheck = 8;
+
+} // namespace
+
+bool RunChainSteps(std::vector<ChainStep> &steps, ChainCursor *cursor,
+                   const TimeSlice *slice) {
+  const size_t num_steps = steps.size();
+  const size_t first_step = cursor->next_step;
+  if (slice == nullptr) {
+    for (size_t i = first_step; i < num_steps; i++) {
+      RunChainStep(steps[i], i, cursor);
+    }
+    cursor->next_step = num_steps;
+    return true;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = first_step; i < num_steps; i++) {
+    const size_t steps_run = i - first_step;
+    if (steps_run > 0) {
+      bool out_of_time = steps[i].Yields();
+      if (slice->max_steps > 0 &&
+          steps_run >= static_cast<size_t>(slice->max_steps)) {
+        out_of_time = true;
+      }
+      if (slice->max_duration.count() > 0 &&
+          steps_run % kStepsPerClockCheck == 0 &&
+          std::chrono::steady_clock::now() - start >= slice->max_duration) {
+        out_of_time = true;
+      }
+      if (out_of_time) {
+        cursor->next_step = i;
+        return false;
+      }
+    }
+    RunChainStep(steps[i], i, cursor);
+  }
+  cursor->next_step = num_steps;
+  return true;
+}
+
+ChainRun::ChainRun(std::vector<ChainStep> steps, size_t slot_size,
+                   size_t slot_align)
+    : steps_(std::move(steps)), slot_align_(slot_align) {
+  const size_t stride = (slot_size + slot_align - 1) / slot_align * slot_align;
+  if (slot_align_ <= kArenaAlignment) {
+    slots_ = static_cast<unsigned char *>(AllocateFrame(2 * stride));
+  } else {
+    slots_ = static_cast<unsigned char *>(
+        ::operator new(2 * stride, std::align_val_t(slot_align_)));
+  }
+  cursor_.in = slots_;
+  cursor_.out = slots_ + stride;
+}
+
+ChainRun::~ChainRun() {
+  // A chain abandoned part way through still owns its intermediate value
+  if (!finished_ && cursor_.next_step > 0 && cursor_.error.ok()) {
+    steps_[cursor_.producer].DestroyOutput(cursor_.in);
+  }
+  if (slot_align_ <= kArenaAlignment) {
+    FreeFrame(slots_);
+  } else {
+    ::operator delete(slots_, std::align_val_t(slot_align_));
+  }
+}
+
+} // namespace internal
+
+namespace {
+
+// Adapts a FuncType task to the intrusive queue
+struct FunctionTask : public IntrusiveTask {
+  explicit FunctionTask(Task task) : task(std::move(task)) { run = &Run; }
+
+  static void Run(IntrusiveTask *self) {
+    std::unique_ptr<FunctionTask> function_task(
+        static_cast<FunctionTask *>(self));
+    std::move(function_task->task)();
+  }
+
+  Task task;
+};
+
+} // namespace
+
+ThreadPoolExecutor::ThreadPoolExecutor(int num_threads, TimeSlice time_slice)
+    : time_slice_(time_slice) {
+  workers_.reserve(num_threads);
+  for (int i = 0; i < num_threads; i++) {
+    workers_.emplace_back([this] { WorkerLoop(); });
+  }
+}
+
+ThreadPoolExecutor::~ThreadPoolExecutor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  tasks_available_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPoolExecutor::Spawn(Task task) {
+  SpawnIntrusive(new FunctionTask(std::move(task)));
+}
+
+void ThreadPoolExecutor::SpawnIntrusive(IntrusiveTask *task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.Push(task);
+  }
+  tasks_available_.notify_one();
+}
+
+void ThreadPoolExecutor::WorkerLoop() {
+  SetCurrent(this);
+  while (true) {
+    IntrusiveTask *task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      tasks_available_.wait(lock,
+                            [this] { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+      task = tasks_.Pop();
+    }
+    task->run(task);
+  }
+}
+
+}
@@ -17,17 +17,26 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <optional>
 #include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "arena.h"
 #include "result.h"
+#include "result_batch.h"
 #include "status.h"
 
 namespace futures {
@@ -36,11 +45,160 @@ namespace futures {
 template <typename Sig> using FuncType = std::function<Sig>;
 
 using Task = FuncType<void()>;
+
+/// \brief How long a task may run before it must give up its thread
+///
+/// A LazyFuture chain that exceeds either limit is re-enqueued on its executor
+/// so that other queued tasks get a chance to run.  A zero limit is ignored.
+struct TimeSlice {
+  int64_t max_steps = 0;
+  std::chrono::microseconds max_duration{0};
+
+  bool limited() const { return max_steps > 0 || max_duration.count() > 0; }
+};
+
+/// \brief A task that carries its own queue link
+///
+/// Embedded at the start of a task's frame so that executors can queue it
+/// without allocating a node or type-erasing it a second time.  `run` is
+/// responsible for the frame from then on: it either frees it or spawns it
+/// again.
+struct IntrusiveTask {
+  IntrusiveTask *next = nullptr;
+  void (*run)(IntrusiveTask *self) = nullptr;
+  // Identifies the code that created the task for executors that adapt per
+  // call site, null if unknown
+  const void *site = nullptr;
+};
+
+class Executor;
+
+namespace internal {
+
+inline thread_local Executor *current_executor = nullptr;
+inline thread_local int inline_depth = 0;
+
+} // namespace internal
+
 class Executor {
 public:
   virtual void Spawn(Task task) = 0;
+  /// \brief Spawn a task without allocating
+  ///
+  /// The default wraps the pointer in a Task, which fits in FuncType's inline
+  /// storage.  Executors with their own queues should link it in directly.
+  virtual void SpawnIntrusive(IntrusiveTask *task) {
+    Spawn([task] { task->run(task); });
+  }
+  /// \brief The time slice for tasks on this executor
+  ///
+  /// Null if the executor cannot re-enqueue a task (e.g. it runs inline), in
+  /// which case time slices and yield points are ignored.
+  virtual const TimeSlice *time_slice() const { return nullptr; }
+  /// \brief Whether work spawned from one of this executor's own tasks may
+  /// run inline, ahead of anything already queued
+  ///
+  /// Executors that promise to run tasks in the order they were spawned
+  /// return false while earlier tasks are still waiting.
+  virtual bool CanRunInline() { return true; }
+
+  /// \brief The executor whose worker thread is calling, if any
+  static Executor *Current() { return internal::current_executor; }
+
+protected:
+  /// \brief Called by an executor's worker threads so that work scheduled
+  /// from them onto the same executor can skip the queue
+  static void SetCurrent(Executor *executor) {
+    internal::current_executor = executor;
+  }
+};
+
+// Work scheduled onto the executor the caller is already running on is run
+// inline, up to this many nested levels deep.  Past that it is queued so
+// that futures consumed from consumers cannot overflow the stack.
+constexpr int kMaxInlineDepth = 16;
+
+namespace internal {
+
+/// \brief A FIFO of IntrusiveTasks linked through their `next` pointers
+class IntrusiveTaskQueue {
+public:
+  bool empty() const { return head_ == nullptr; }
+
+  void Push(IntrusiveTask *task) {
+    task->next = nullptr;
+    if (tail_ == nullptr) {
+      head_ = task;
+    } else {
+      tail_->next = task;
+    }
+    tail_ = task;
+  }
+
+  IntrusiveTask *Pop() {
+    IntrusiveTask *task = head_;
+    head_ = task->next;
+    if (head_ == nullptr) {
+      tail_ = nullptr;
+    }
+    return task;
+  }
+
+private:
+  IntrusiveTask *head_ = nullptr;
+  IntrusiveTask *tail_ = nullptr;
+};
+
+/// \brief A heap frame holding a callable and its queue link, allocated from
+/// the current arena if there is one
+///
+/// `Fn` returns true once it has finished, or false if it needs to be run
+/// again later, in which case the same frame is re-enqueued.
+template <typename Fn> class ResumableTask : public IntrusiveTask {
+public:
+  ResumableTask(Fn fn, Executor *executor)
+      : fn_(std::move(fn)), executor_(executor) {
+    run = &Run;
+  }
+
+private:
+  static void Run(IntrusiveTask *self) {
+    auto *task = static_cast<ResumableTask *>(self);
+    if (task->fn_()) {
+      DeleteFrame(task);
+    } else {
+      task->executor_->SpawnIntrusive(task);
+    }
+  }
+
+  Fn fn_;
+  Executor *executor_;
 };
 
+/// \brief Run task on executor, inline if the caller is already one of its
+/// workers
+///
+/// `task` returns true once finished or false if it should be re-enqueued.
+/// `site` is recorded on the spawned task, see IntrusiveTask::site.
+template <typename Fn>
+void SpawnOrRunInline(Executor *executor, Fn task,
+                      const void *site = nullptr) {
+  if (Executor::Current() == executor && inline_depth < kMaxInlineDepth &&
+      executor->CanRunInline()) {
+    inline_depth++;
+    const bool finished = task();
+    inline_depth--;
+    if (finished) {
+      return;
+    }
+  }
+  auto *frame = NewFrame<ResumableTask<Fn>>(std::move(task), executor);
+  frame->site = site;
+  executor->SpawnIntrusive(frame);
+}
+
+} // namespace internal
+
 class ThreadPerTaskExecutor : public Executor {
 public:
   virtual ~ThreadPerTaskExecutor() {
@@ -59,6 +217,29 @@ class InlineExecutor : public Executor {
   void Spawn(Task task) override { std::move(task)(); }
 };
 
+/// \brief A fixed number of threads servicing a shared FIFO queue
+///
+/// Queued tasks are drained before the destructor returns.
+class ThreadPoolExecutor : public Executor {
+public:
+  explicit ThreadPoolExecutor(int num_threads, TimeSlice time_slice = {});
+  virtual ~ThreadPoolExecutor();
+
+  void Spawn(Task task) override;
+  void SpawnIntrusive(IntrusiveTask *task) override;
+  const TimeSlice *time_slice() const override { return &time_slice_; }
+
+private:
+  void WorkerLoop();
+
+  const TimeSlice time_slice_;
+  std::mutex mutex_;
+  std::condition_variable tasks_available_;
+  internal::IntrusiveTaskQueue tasks_;
+  bool stopping_ = false;
+  std::vector<std::thread> workers_;
+};
+
 template <typename T> using Consumer = FuncType<void(Result<T>)>;
 
 template <typename T>
@@ -66,8 +247,6 @@ class Promise {
     Promise(Consumer<T> callback) : callback_(std::move(callback)) {}
     Promise(const Consumer<T>&) = delete;
     Promise& operator=(const Consumer<T>&) = delete;
-    Promise(Consumer<T>&&) = default;
-    Promise& operator=(Consumer<T>&&) = default;
     ~Promise() {
         if (callback_) {
             std::move(callback_)(Status::Invalid("Abandoned promise"));
@@ -81,138 +260,787 @@ private:
     Consumer<T> callback_;
 };
 
-template <typename T> using Supplier = FuncType<void(Promise<T>)>;
+template <typename T> using Supplier = FuncType<Result<T>()>;
 template <typename T, typename V>
 using MapTask = FuncType<Result<V>(Result<T>)>;
 template <typename T> using MapTaskVoid = FuncType<Status(Result<T>)>;
+template <typename T, typename V> using OkMapTask = FuncType<Result<V>(T)>;
+template <typename T> using ErrorMapTask = FuncType<Result<T>(Status)>;
+
+/// \brief Storage for the output of a ThenEmplace continuation
+///
+/// Emplace constructs the value directly in the slot that the next step of
+/// the chain reads from, so it is never moved on the way.
+template <typename V> class Emplacer {
+public:
+  explicit Emplacer(void *slot) : slot_(slot) {}
+  Emplacer(const Emplacer &) = delete;
+  Emplacer &operator=(const Emplacer &) = delete;
+
+  /// \brief Construct the output from `args`, replacing any earlier one
+  template <typename... A> V &Emplace(A &&...args) {
+    Reset();
+    auto *result =
+        new (slot_) Result<V>(std::in_place, std::forward<A>(args)...);
+    emplaced_ = true;
+    return result->ValueUnsafe();
+  }
+
+  bool emplaced() const { return emplaced_; }
+
+  void Reset() {
+    if (emplaced_) {
+      static_cast<Result<V> *>(slot_)->~Result<V>();
+      emplaced_ = false;
+    }
+  }
+
+private:
+  void *slot_;
+  bool emplaced_ = false;
+};
+
+/// \brief A continuation that reads its input in place and emplaces its
+/// output, returning OK once it has
+template <typename T, typename V>
+using EmplaceMapTask = FuncType<Status(T &&, Emplacer<V> &)>;
+/// \brief A continuation that modifies the value where it is stored
+template <typename T> using InPlaceMapTask = FuncType<Status(T &)>;
 
 using VoidSupplier = FuncType<Status()>;
 using VoidConsumer = FuncType<void(Status)>;
 template <typename V> using VoidMapTask = FuncType<Result<V>(Status)>;
 using VoidMapTaskVoid = FuncType<Status(Status)>;
+template <typename V> using VoidOkMapTask = FuncType<Result<V>()>;
+using VoidErrorMapTask = FuncType<Status(Status)>;
 
-template <typename T, typename V>
-Supplier<V> Compose(Supplier<T> supplier, MapTask<T, V> continuation) {
-  struct Composition {
-    Result<V> operator()() {
-      return std::move(continuation)(std::move(supplier)());
-    }
-    Supplier<T> supplier;
-    MapTask<T, V> continuation;
+namespace internal {
+
+/// \brief One type-erased step of a Chain
+///
+/// Steps communicate through two slots that are large enough for any Result
+/// in the chain.  An ok Result lives in a slot while an error is carried
+/// separately as a Status so that steps which do not handle errors can be
+/// skipped without touching it.
+class ChainStep {
+public:
+  struct Ops {
+    // Consumes the ok Result<T> in `in`.  Either constructs an ok Result<V> in
+    // `out` or leaves `out` empty and stores the failure in `error`.  Null if
+    // values pass through the step untouched.
+    void (*on_value)(void *fn, void *in, void *out, Status *error);
+    // Consumes the failure in `error`.  Either constructs an ok Result<V> in
+    // `out` (resetting `error`) or replaces `error`.  Null if errors pass
+    // through the step untouched.
+    void (*on_error)(void *fn, Status *error, void *out);
+    // Destroys a Result<V> produced by this step
+    void (*destroy_output)(void *slot);
+    void (*copy_construct)(const void *src, void *dest);
+    void (*move_construct)(void *src, void *dest);
+    void (*destroy)(void *fn);
+    // The type of the user's callable, as a call site for adaptive
+    // executors.  Null for steps without one.
+    const void *(*site)(const void *fn);
+    // If true the chain may be suspended and re-enqueued before this step
+    bool yields;
+    // If true on_value leaves its ok Result in `in` rather than `out`.  On
+    // failure it destroys the Result in `in` instead.
+    bool in_place;
   };
-  return Supplier<V>(Composition{std::move(supplier), std::move(continuation)});
-}
 
-template <typename T>
-VoidSupplier ComposeVoid(Supplier<T> supplier,
-                         MapTaskVoid<T> continuation_void) {
-  struct Composition {
-    Status operator()() {
-      return std::move(continuation_void)(std::move(supplier)());
+  template <typename Fn> ChainStep(const Ops *ops, Fn fn) : ops_(ops) {
+    static_assert(sizeof(Fn) <= sizeof(storage_) &&
+                      alignof(Fn) <= alignof(FuncType<void()>),
+                  "ChainStep callables must fit in a FuncType");
+    new (storage_) Fn(std::move(fn));
+  }
+  ChainStep(const ChainStep &other) : ops_(other.ops_) {
+    ops_->copy_construct(other.storage_, storage_);
+  }
+  ChainStep(ChainStep &&other) noexcept : ops_(other.ops_) {
+    ops_->move_construct(other.storage_, storage_);
+  }
+  ChainStep &operator=(const ChainStep &) = delete;
+  ChainStep &operator=(ChainStep &&) = delete;
+  ~ChainStep() { ops_->destroy(storage_); }
+
+  bool HandlesValue() const { return ops_->on_value != nullptr; }
+  bool HandlesError() const { return ops_->on_error != nullptr; }
+  bool Yields() const { return ops_->yields; }
+  bool InPlace() const { return ops_->in_place; }
+  void OnValue(void *in, void *out, Status *error) {
+    ops_->on_value(storage_, in, out, error);
+  }
+  void OnError(Status *error, void *out) {
+    ops_->on_error(storage_, error, out);
+  }
+  void DestroyOutput(void *slot) const { ops_->destroy_output(slot); }
+  const void *Site() const { return ops_->site(storage_); }
+
+private:
+  const Ops *ops_;
+  alignas(FuncType<void()>) unsigned char storage_[sizeof(FuncType<void()>)];
+};
+
+/// \brief Where a running chain is up to
+struct ChainCursor {
+  size_t next_step = 0;
+  // The step that produced the Result held in `in`.  Only meaningful if
+  // next_step > 0 and error is ok.
+  size_t producer = 0;
+  void *in = nullptr;
+  void *out = nullptr;
+  Status error;
+};
+
+/// \brief Run the remaining steps of a chain in a loop
+///
+/// If `slice` is null every remaining step is run.  Otherwise the loop stops
+/// early at a yield point or once the slice is used up.  Returns true if the
+/// chain has finished, in which case `cursor->in` holds the final Result
+/// (unless `cursor->error` is set).
+bool RunChainSteps(std::vector<ChainStep> &steps, ChainCursor *cursor,
+                   const TimeSlice *slice);
+
+/// \brief The state of a chain that may be suspended between slices
+///
+/// Owns the steps and heap-allocated slots so that a partially run chain can
+/// be moved to another task.
+class ChainRun {
+public:
+  ChainRun(std::vector<ChainStep> steps, size_t slot_size, size_t slot_align);
+  ~ChainRun();
+  ChainRun(const ChainRun &) = delete;
+  ChainRun &operator=(const ChainRun &) = delete;
+
+  /// \brief Run until finished (returns true) or the slice is used up
+  bool Resume(const TimeSlice &slice) {
+    return RunChainSteps(steps_, &cursor_, &slice);
+  }
+
+  /// \brief The final state, the caller takes ownership of any value in
+  /// cursor().in
+  ChainCursor *Finish() {
+    finished_ = true;
+    return &cursor_;
+  }
+
+private:
+  std::vector<ChainStep> steps_;
+  size_t slot_align_;
+  unsigned char *slots_;
+  ChainCursor cursor_;
+  bool finished_ = false;
+};
+
+template <typename Fn> struct ChainStepStorage {
+  static void CopyConstruct(const void *src, void *dest) {
+    new (dest) Fn(*static_cast<const Fn *>(src));
+  }
+  static void MoveConstruct(void *src, void *dest) {
+    new (dest) Fn(std::move(*static_cast<Fn *>(src)));
+  }
+  static void Destroy(void *fn) { static_cast<Fn *>(fn)->~Fn(); }
+  static const void *Site(const void *fn) {
+    if constexpr (std::is_same_v<Fn, Empty>) {
+      return nullptr;
+    } else {
+      return &static_cast<const Fn *>(fn)->target_type();
     }
-    Supplier<T> supplier;
-    MapTaskVoid<T> continuation_void;
-  };
-  return VoidSupplier(
-      Composition{std::move(supplier), std::move(continuation_void)});
+  }
+};
+
+template <typename V> void DestroyChainOutput(void *slot) {
+  static_cast<Result<V> *>(slot)->~Result<V>();
 }
 
-template <typename V>
-Supplier<V> VoidCompose(VoidSupplier supplier, VoidMapTask<V> continuation) {
-  struct Composition {
-    Result<V> operator()() {
-      return std::move(continuation)(std::move(supplier)());
-    }
-    VoidSupplier supplier;
-    VoidMapTask<V> continuation;
-  };
-  return Supplier<V>(Composition{std::move(supplier), std::move(continuation)});
+template <typename Fn, typename V>
+constexpr ChainStep::Ops
+MakeChainStepOps(decltype(ChainStep::Ops::on_value) on_value,
+                 decltype(ChainStep::Ops::on_error) on_error,
+                 bool yields = false, bool in_place = false) {
+  return {on_value,
+          on_error,
+          &DestroyChainOutput<V>,
+          &ChainStepStorage<Fn>::CopyConstruct,
+          &ChainStepStorage<Fn>::MoveConstruct,
+          &ChainStepStorage<Fn>::Destroy,
+          &ChainStepStorage<Fn>::Site,
+          yields,
+          in_place};
 }
 
-inline VoidSupplier VoidComposeVoid(VoidSupplier supplier,
-                                    VoidMapTaskVoid continuation) {
-  struct Composition {
-    Status operator()() {
-      return std::move(continuation)(std::move(supplier)());
-    }
-    VoidSupplier supplier;
-    VoidMapTaskVoid continuation;
-  };
-  return VoidSupplier(
-      Composition{std::move(supplier), std::move(continuation)});
+// Constructs the Result<V> returned by `produce` directly in `out`, or
+// stores its failure in `error` and leaves `out` empty
+template <typename V, typename Produce>
+void EmitChainResult(Produce &&produce, void *out, Status *error) {
+  auto *result = new (out) Result<V>(produce());
+  if (result->ok()) [[likely]] {
+    *error = Status::OK();
+  } else {
+    *error = result->status();
+    result->~Result<V>();
+  }
 }
 
+template <typename T> Result<T> TakeChainResult(ChainCursor *cursor) {
+  // A single named result so that it is returned without another move
+  Result<T> result(cursor->error.ok()
+                       ? std::move(*static_cast<Result<T> *>(cursor->in))
+                       : Result<T>(cursor->error));
+  if (cursor->error.ok()) [[likely]] {
+    static_cast<Result<T> *>(cursor->in)->~Result<T>();
+  }
+  return result;
+}
+
+template <typename T> struct SourceChainStep {
+  using Fn = Supplier<T>;
+  static void OnValue(void *fn, void *, void *out, Status *error) {
+    EmitChainResult<T>([&] { return (*static_cast<Fn *>(fn))(); }, out,
+                       error);
+  }
+  static constexpr ChainStep::Ops kOps =
+      MakeChainStepOps<Fn, T>(&OnValue, nullptr);
+};
+
+template <typename T, typename V> struct ThenChainStep {
+  using Fn = MapTask<T, V>;
+  static void OnValue(void *fn, void *in, void *out, Status *error) {
+    Result<T> *value = static_cast<Result<T> *>(in);
+    EmitChainResult<V>(
+        [&] { return (*static_cast<Fn *>(fn))(std::move(*value)); }, out,
+        error);
+    value->~Result<T>();
+  }
+  static void OnError(void *fn, Status *error, void *out) {
+    EmitChainResult<V>(
+        [&] { return (*static_cast<Fn *>(fn))(Result<T>(*error)); }, out,
+        error);
+  }
+  static constexpr ChainStep::Ops kOps =
+      MakeChainStepOps<Fn, V>(&OnValue, &OnError);
+};
+
+template <typename T, typename V> struct ThenOkChainStep {
+  using Fn = OkMapTask<T, V>;
+  static void OnValue(void *fn, void *in, void *out, Status *error) {
+    Result<T> *value = static_cast<Result<T> *>(in);
+    EmitChainResult<V>(
+        [&] { return (*static_cast<Fn *>(fn))(value->MoveValueUnsafe()); },
+        out, error);
+    value->~Result<T>();
+  }
+  static constexpr ChainStep::Ops kOps =
+      MakeChainStepOps<Fn, V>(&OnValue, nullptr);
+};
+
+template <typename T, typename V> struct ThenEmplaceChainStep {
+  using Fn = EmplaceMapTask<T, V>;
+  static void OnValue(void *fn, void *in, void *out, Status *error) {
+    Result<T> *value = static_cast<Result<T> *>(in);
+    Emplacer<V> emplacer(out);
+    Status status =
+        (*static_cast<Fn *>(fn))(std::move(value->ValueUnsafe()), emplacer);
+    value->~Result<T>();
+    if (status.ok() && !emplacer.emplaced()) [[unlikely]] {
+      status = Status::Invalid("ThenEmplace continuation returned OK "
+                               "without emplacing a value");
+    }
+    if (!status.ok()) [[unlikely]] {
+      emplacer.Reset();
+    }
+    *error = std::move(status);
+  }
+  static constexpr ChainStep::Ops kOps =
+      MakeChainStepOps<Fn, V>(&OnValue, nullptr);
+};
+
+template <typename T> struct ThenInPlaceChainStep {
+  using Fn = InPlaceMapTask<T>;
+  static void OnValue(void *fn, void *in, void *, Status *error) {
+    Result<T> *value = static_cast<Result<T> *>(in);
+    Status status = (*static_cast<Fn *>(fn))(value->ValueUnsafe());
+    if (!status.ok()) [[unlikely]] {
+      value->~Result<T>();
+    }
+    *error = std::move(status);
+  }
+  static constexpr ChainStep::Ops kOps = MakeChainStepOps<Fn, T>(
+      &OnValue, nullptr, /*yields=*/false, /*in_place=*/true);
+};
+
+template <typename T> struct OnErrorChainStep {
+  using Fn = ErrorMapTask<T>;
+  static void OnError(void *fn, Status *error, void *out) {
+    EmitChainResult<T>(
+        [&] { return (*static_cast<Fn *>(fn))(std::move(*error)); }, out,
+        error);
+  }
+  static constexpr ChainStep::Ops kOps =
+      MakeChainStepOps<Fn, T>(nullptr, &OnError);
+};
+
+template <typename T> struct ThenVoidChainStep {
+  using Fn = MapTaskVoid<T>;
+  static void OnValue(void *fn, void *in, void *out, Status *error) {
+    Result<T> *value = static_cast<Result<T> *>(in);
+    EmitChainResult<Empty>(
+        [&] {
+          return Empty::ToResult((*static_cast<Fn *>(fn))(std::move(*value)));
+        },
+        out, error);
+    value->~Result<T>();
+  }
+  static void OnError(void *fn, Status *error, void *out) {
+    EmitChainResult<Empty>(
+        [&] {
+          return Empty::ToResult((*static_cast<Fn *>(fn))(Result<T>(*error)));
+        },
+        out, error);
+  }
+  static constexpr ChainStep::Ops kOps =
+      MakeChainStepOps<Fn, Empty>(&OnValue, &OnError);
+};
+
+// The steps below make up the chain of a LazyFuture<void>, which carries a
+// Result<Empty> so that it shares the loop (and its error skipping) with
+// every other chain.
+
+struct VoidSourceChainStep {
+  using Fn = VoidSupplier;
+  static void OnValue(void *fn, void *, void *out, Status *error) {
+    EmitChainResult<Empty>(
+        [&] { return Empty::ToResult((*static_cast<Fn *>(fn))()); }, out,
+        error);
+  }
+  static constexpr ChainStep::Ops kOps =
+      MakeChainStepOps<Fn, Empty>(&OnValue, nullptr);
+};
+
+template <typename V> struct VoidThenChainStep {
+  using Fn = VoidMapTask<V>;
+  static void OnValue(void *fn, void *in, void *out, Status *error) {
+    static_cast<Result<Empty> *>(in)->~Result<Empty>();
+    EmitChainResult<V>([&] { return (*static_cast<Fn *>(fn))(Status::OK()); },
+                       out, error);
+  }
+  static void OnError(void *fn, Status *error, void *out) {
+    EmitChainResult<V>(
+        [&] { return (*static_cast<Fn *>(fn))(std::move(*error)); }, out,
+        error);
+  }
+  static constexpr ChainStep::Ops kOps =
+      MakeChainStepOps<Fn, V>(&OnValue, &OnError);
+};
+
+template <typename V> struct VoidThenOkChainStep {
+  using Fn = VoidOkMapTask<V>;
+  static void OnValue(void *fn, void *in, void *out, Status *error) {
+    static_cast<Result<Empty> *>(in)->~Result<Empty>();
+    EmitChainResult<V>([&] { return (*static_cast<Fn *>(fn))(); }, out, error);
+  }
+  static constexpr ChainStep::Ops kOps =
+      MakeChainStepOps<Fn, V>(&OnValue, nullptr);
+};
+
+struct VoidThenVoidChainStep {
+  using Fn = VoidMapTaskVoid;
+  static void OnValue(void *fn, void *in, void *out, Status *error) {
+    static_cast<Result<Empty> *>(in)->~Result<Empty>();
+    EmitChainResult<Empty>(
+        [&] { return Empty::ToResult((*static_cast<Fn *>(fn))(Status::OK())); },
+        out, error);
+  }
+  static void OnError(void *fn, Status *error, void *out) {
+    EmitChainResult<Empty>(
+        [&] {
+          return Empty::ToResult((*static_cast<Fn *>(fn))(std::move(*error)));
+        },
+        out, error);
+  }
+  static constexpr ChainStep::Ops kOps =
+      MakeChainStepOps<Fn, Empty>(&OnValue, &OnError);
+};
+
+struct VoidOnErrorChainStep {
+  using Fn = VoidErrorMapTask;
+  static void OnError(void *fn, Status *error, void *out) {
+    EmitChainResult<Empty>(
+        [&] {
+          return Empty::ToResult((*static_cast<Fn *>(fn))(std::move(*error)));
+        },
+        out, error);
+  }
+  static constexpr ChainStep::Ops kOps =
+      MakeChainStepOps<Fn, Empty>(nullptr, &OnError);
+};
+
+template <typename T> struct YieldChainStep {
+  using Fn = Empty;
+  static constexpr ChainStep::Ops kOps =
+      MakeChainStepOps<Fn, T>(nullptr, nullptr, /*yields=*/true);
+};
+
+// Chains whose largest Result fits in this many bytes run without allocating
+// their slots.
+constexpr size_t kInlineChainSlotSize = 64;
+
+/// \brief A supplier followed by a flat sequence of continuations
+///
+/// Unlike nested Compose calls, running a chain does not recurse.  Every step
+/// is stored contiguously and driven by a single loop, and the storage for the
+/// intermediate results is allocated once per run rather than per step.
+template <typename T> class Chain {
+public:
+  explicit Chain(Supplier<T> source) {
+    steps_.emplace_back(&SourceChainStep<T>::kOps, std::move(source));
+  }
+
+  /// \brief A chain that starts with some other kind of source step
+  template <typename Step> static Chain FromSource(typename Step::Fn source) {
+    Chain chain;
+    chain.steps_.emplace_back(&Step::kOps, std::move(source));
+    return chain;
+  }
+
+  /// \brief Append any kind of step, producing a Result<V>
+  template <typename V, typename Step>
+  Chain<V> ThenStep(typename Step::Fn fn) && {
+    return std::move(*this).template Append<V>(
+        ChainStep(&Step::kOps, std::move(fn)));
+  }
+
+  template <typename V> Chain<V> Then(MapTask<T, V> map_func) && {
+    return std::move(*this).template Append<V>(
+        ChainStep(&ThenChainStep<T, V>::kOps, std::move(map_func)));
+  }
+
+  template <typename V> Chain<V> ThenOk(OkMapTask<T, V> map_func) && {
+    return std::move(*this).template Append<V>(
+        ChainStep(&ThenOkChainStep<T, V>::kOps, std::move(map_func)));
+  }
+
+  template <typename V>
+  Chain<V> ThenEmplace(EmplaceMapTask<T, V> map_func) && {
+    return std::move(*this).template Append<V>(
+        ChainStep(&ThenEmplaceChainStep<T, V>::kOps, std::move(map_func)));
+  }
+
+  Chain<T> ThenInPlace(InPlaceMapTask<T> map_func) && {
+    return std::move(*this).template Append<T>(
+        ChainStep(&ThenInPlaceChainStep<T>::kOps, std::move(map_func)));
+  }
+
+  Chain<T> OnError(ErrorMapTask<T> handler) && {
+    return std::move(*this).template Append<T>(
+        ChainStep(&OnErrorChainStep<T>::kOps, std::move(handler)));
+  }
+
+  Chain<T> Yield() && {
+    Chain<T> next = std::move(*this).template Append<T>(
+        ChainStep(&YieldChainStep<T>::kOps, Empty{}));
+    next.has_yield_points_ = true;
+    return next;
+  }
+
+  /// \brief Run every step on the calling thread, ignoring yield points
+  Result<T> operator()() {
+    const size_t stride =
+        (slot_size_ + slot_align_ - 1) / slot_align_ * slot_align_;
+    if (stride <= kInlineChainSlotSize &&
+        slot_align_ <= alignof(std::max_align_t)) [[likely]] {
+      alignas(std::max_align_t) unsigned char slots[2 * kInlineChainSlotSize];
+      return Run(slots, slots + kInlineChainSlotSize);
+    }
+    auto *slots = static_cast<unsigned char *>(
+        ::operator new(2 * stride, std::align_val_t(slot_align_)));
+    Result<T> result = Run(slots, slots + stride);
+    ::operator delete(slots, std::align_val_t(slot_align_));
+    return result;
+  }
+
+  /// \brief Whether running on an executor with the given time slice can ever
+  /// suspend this chain
+  bool CanSuspend(const TimeSlice *slice) const {
+    return slice != nullptr && (has_yield_points_ || slice->limited());
+  }
+
+  /// \brief Run until the chain finishes (returns true) or has to yield
+  ///
+  /// Once this returns true the result is available from TakeResult.
+  bool Resume(const TimeSlice &slice) {
+    if (!run_) {
+      run_ = std::allocate_shared<ChainRun>(ArenaAllocator<ChainRun>(),
+                                            std::move(steps_), slot_size_,
+                                            slot_align_);
+    }
+    return run_->Resume(slice);
+  }
+
+  Result<T> TakeResult() { return TakeChainResult<T>(run_->Finish()); }
+
+  size_t num_steps() const { return steps_.size(); }
+
+  /// \brief Where this chain was built, taken from its last callable
+  ///
+  /// Chains built by the same code end in the same lambda so they share a
+  /// site, while two chains ending in different lambdas do not.
+  const void *site() const {
+    for (auto it = steps_.rbegin(); it != steps_.rend(); ++it) {
+      if (const void *site = it->Site()) {
+        return site;
+      }
+    }
+    return nullptr;
+  }
+
+private:
+  template <typename> friend class Chain;
+
+  Chain() = default;
+
+  template <typename V> Chain<V> Append(ChainStep step) && {
+    Chain<V> next;
+    next.steps_ = std::move(steps_);
+    next.steps_.push_back(std::move(step));
+    next.slot_size_ = std::max(slot_size_, sizeof(Result<V>));
+    next.slot_align_ = std::max(slot_align_, alignof(Result<V>));
+    next.has_yield_points_ = has_yield_points_;
+    return next;
+  }
+
+  Result<T> Run(void *slot_a, void *slot_b) {
+    ChainCursor cursor;
+    cursor.in = slot_a;
+    cursor.out = slot_b;
+    RunChainSteps(steps_, &cursor, nullptr);
+    return TakeChainResult<T>(&cursor);
+  }
+
+  std::vector<ChainStep> steps_;
+  size_t slot_size_ = sizeof(Result<T>);
+  size_t slot_align_ = alignof(Result<T>);
+  bool has_yield_points_ = false;
+  // Only set once a suspendable run has started.  Shared so the chain stays
+  // copyable for FuncType, a started chain is never actually copied.
+  std::shared_ptr<ChainRun> run_;
+};
+
+} // namespace internal
+
 template <typename T> class LazyFuture;
 
 template <> class LazyFuture<void> {
 public:
   LazyFuture(VoidSupplier supplier, Executor *executor)
-      : supplier_(std::move(supplier)), executor_(std::move(executor)) {}
+      : chain_(VoidChain::FromSource<internal::VoidSourceChainStep>(
+            std::move(supplier))),
+        executor_(executor) {}
 
   void ConsumeAsync(VoidConsumer consumer) && {
     struct VoidFutureRunningTask {
-      void operator()() { std::move(consumer)(std::move(supplier)()); }
-      VoidSupplier supplier;
+      // Returns false if out of time and needs to go to the back of the queue
+      bool operator()() {
+        const TimeSlice *slice = executor->time_slice();
+        if (!chain.CanSuspend(slice)) [[likely]] {
+          std::move(consumer)(chain().status());
+        } else if (chain.Resume(*slice)) {
+          std::move(consumer)(chain.TakeResult().status());
+        } else {
+          return false;
+        }
+        return true;
+      }
+      VoidChain chain;
       VoidConsumer consumer;
+      Executor *executor;
     };
     Executor *executor = executor_;
-    VoidFutureRunningTask task{std::move(supplier_), std::move(consumer)};
-    executor->Spawn(std::move(task));
+    const void *site = chain_.site();
+    VoidFutureRunningTask task{std::move(chain_), std::move(consumer),
+                               executor};
+    internal::SpawnOrRunInline(executor, std::move(task), site);
   }
 
   template <typename V> LazyFuture<V> Then(VoidMapTask<V> map_func) && {
-    Supplier<V> continued =
-        VoidCompose<V>(std::move(supplier_), std::move(map_func));
-    return LazyFuture<V>(std::move(continued), executor_);
+    return LazyFuture<V>(
+        std::move(chain_)
+            .template ThenStep<V, internal::VoidThenChainStep<V>>(
+                std::move(map_func)),
+        executor_);
   }
 
   LazyFuture<void> ThenVoid(VoidMapTaskVoid map_func) && {
-    VoidSupplier continued =
-        VoidComposeVoid(std::move(supplier_), std::move(map_func));
-    return LazyFuture<void>(std::move(continued), executor_);
+    return LazyFuture<void>(
+        std::move(chain_)
+            .ThenStep<internal::Empty, internal::VoidThenVoidChainStep>(
+                std::move(map_func)),
+        executor_);
+  }
+
+  /// \brief Run this future on a different executor
+  LazyFuture<void> Via(Executor *executor) && {
+    return LazyFuture<void>(std::move(chain_), executor);
+  }
+
+  /// \brief Continue only on success, errors skip map_func entirely
+  template <typename V> LazyFuture<V> ThenOk(VoidOkMapTask<V> map_func) && {
+    return LazyFuture<V>(
+        std::move(chain_)
+            .template ThenStep<V, internal::VoidThenOkChainStep<V>>(
+                std::move(map_func)),
+        executor_);
+  }
+
+  /// \brief Continue only on error, success skips handler entirely
+  LazyFuture<void> OnError(VoidErrorMapTask handler) && {
+    return LazyFuture<void>(
+        std::move(chain_)
+            .ThenStep<internal::Empty, internal::VoidOnErrorChainStep>(
+                std::move(handler)),
+        executor_);
   }
 
 private:
-  VoidSupplier supplier_;
+  template <typename> friend class LazyFuture;
+  using VoidChain = internal::Chain<internal::Empty>;
+
+  LazyFuture(VoidChain chain, Executor *executor)
+      : chain_(std::move(chain)), executor_(executor) {}
+
+  VoidChain chain_;
   Executor *executor_;
 };
 
 template <typename T> class LazyFuture {
 public:
   LazyFuture(Supplier<T> supplier, Executor *executor)
-      : supplier_(std::move(supplier)), executor_(executor) {}
+      : chain_(std::move(supplier)), executor_(executor) {}
 
   void ConsumeAsync(Consumer<T> consumer) && {
     struct FutureRunningTask {
-      void operator()() { std::move(consumer)(std::move(supplier)()); }
-      Supplier<T> supplier;
+      // Returns false if out of time and needs to go to the back of the queue
+      bool operator()() {
+        const TimeSlice *slice = executor->time_slice();
+        if (!chain.CanSuspend(slice)) [[likely]] {
+          std::move(consumer)(chain());
+        } else if (chain.Resume(*slice)) {
+          std::move(consumer)(chain.TakeResult());
+        } else {
+          return false;
+        }
+        return true;
+      }
+      internal::Chain<T> chain;
       Consumer<T> consumer;
+      Executor *executor;
     };
     Executor *executor = executor_;
-    FutureRunningTask task{std::move(supplier_), std::move(consumer)};
-    executor->Spawn(std::move(task));
+    const void *site = chain_.site();
+    FutureRunningTask task{std::move(chain_), std::move(consumer), executor};
+    internal::SpawnOrRunInline(executor, std::move(task), site);
   }
 
   template <typename V> LazyFuture<V> Then(MapTask<T, V> map_func) && {
-    Supplier<V> continued =
-        Compose<T, V>(std::move(supplier_), std::move(map_func));
-    return LazyFuture<V>(std::move(continued), executor_);
+    return LazyFuture<V>(
+        std::move(chain_).template Then<V>(std::move(map_func)), executor_);
+  }
+
+  /// \brief Continue only on success, errors skip map_func entirely
+  template <typename V> LazyFuture<V> ThenOk(OkMapTask<T, V> map_func) && {
+    return LazyFuture<V>(
+        std::move(chain_).template ThenOk<V>(std::move(map_func)), executor_);
+  }
+
+  /// \brief Continue only on success, building the output in place
+  ///
+  /// map_func gets a reference to the value in the chain's storage and
+  /// constructs its output with Emplacer::Emplace directly in the storage the
+  /// next step reads from, so neither is moved between steps.
+  template <typename V>
+  LazyFuture<V> ThenEmplace(EmplaceMapTask<T, V> map_func) && {
+    return LazyFuture<V>(
+        std::move(chain_).template ThenEmplace<V>(std::move(map_func)),
+        executor_);
+  }
+
+  /// \brief Continue only on success, modifying the value in place
+  ///
+  /// For steps that map a T to a T.  map_func gets a reference to the value
+  /// where the previous step stored it and changes it there, so no new Result
+  /// is constructed and nothing is moved.  An error from map_func replaces the
+  /// value.
+  LazyFuture<T> ThenInPlace(InPlaceMapTask<T> map_func) && {
+    return LazyFuture<T>(std::move(chain_).ThenInPlace(std::move(map_func)),
+                         executor_);
+  }
+
+  /// \brief Continue only on error, success skips handler entirely
+  LazyFuture<T> OnError(ErrorMapTask<T> handler) && {
+    return LazyFuture<T>(std::move(chain_).OnError(std::move(handler)),
+                         executor_);
+  }
+
+  /// \brief Give other tasks on the executor a chance to run before continuing
+  ///
+  /// Only has an effect on executors with a time slice.
+  LazyFuture<T> Yield() && {
+    return LazyFuture<T>(std::move(chain_).Yield(), executor_);
+  }
+
+  /// \brief Run this future on a different executor
+  LazyFuture<T> Via(Executor *executor) && {
+    return LazyFuture<T>(std::move(chain_), executor);
   }
 
   template <typename V>
   LazyFuture<V> ThenFuture(MapTask<T, LazyFuture<V>> map_func) && {}
 
   LazyFuture<void> ThenVoid(MapTaskVoid<T> map_func) && {
-    VoidSupplier continued =
-        ComposeVoid<T>(std::move(supplier_), std::move(map_func));
-    return LazyFuture<void>(std::move(continued), executor_);
+    return LazyFuture<void>(
+        std::move(chain_)
+            .template ThenStep<internal::Empty,
+                               internal::ThenVoidChainStep<T>>(
+                std::move(map_func)),
+        executor_);
   }
 
 private:
-  Supplier<T> supplier_;
+  template <typename> friend class LazyFuture;
+  template <typename U>
+  friend LazyFuture<ResultBatch<U>>
+  CollectBatch(std::vector<LazyFuture<U>> futures, Executor *executor);
+
+  LazyFuture(internal::Chain<T> chain, Executor *executor)
+      : chain_(std::move(chain)), executor_(executor) {}
+
+  internal::Chain<T> chain_;
   Executor *executor_;
 };
 
+/// \brief Run `futures` one after another on a single task of `executor`
+/// and gather their results into one batch
+///
+/// The executors the futures were created with are not used.
+template <typename T>
+LazyFuture<ResultBatch<T>> CollectBatch(std::vector<LazyFuture<T>> futures,
+                                        Executor *executor) {
+  auto pending =
+      std::make_shared<std::vector<LazyFuture<T>>>(std::move(futures));
+  return LazyFuture<ResultBatch<T>>(
+      [pending]() -> Result<ResultBatch<T>> {
+        ResultBatch<T> batch;
+        batch.Reserve(static_cast<int64_t>(pending->size()));
+        for (auto &future : *pending) {
+          batch.Append(future.chain_());
+        }
+        pending->clear();
+        return batch;
+      },
+      executor);
+}
+
 // template <typename T>
 // LazyFuture<std::vector<Result<T>>>
 // All(const std::vector<LazyFuture<T>> &futures) {
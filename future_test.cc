@@ -1,5 +1,12 @@
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -58,4 +65,520 @@ TEST(LazyFutureTest, MoveToDifferentScope) {
   ASSERT_TRUE(callback_ran);
 }
 
+TEST(LazyFutureTest, ThenOkSkipsOnError) {
+  InlineExecutor executor;
+  int calls = 0;
+  Supplier<int> supplier = []() -> Result<int> {
+    return Status::Invalid("XYZ");
+  };
+  LazyFuture<int> fut(std::move(supplier), &executor);
+  LazyFuture<int> continued = std::move(fut).ThenOk<int>([&](int val) {
+    calls++;
+    return val + 1;
+  });
+  continued = std::move(continued).ThenOk<int>([&](int val) {
+    calls++;
+    return val + 1;
+  });
+
+  bool callback_ran = false;
+  std::move(continued).ConsumeAsync([&](Result<int> val) {
+    callback_ran = true;
+    ASSERT_TRUE(val.status().IsInvalid());
+  });
+  ASSERT_TRUE(callback_ran);
+  ASSERT_EQ(0, calls);
+}
+
+TEST(LazyFutureTest, OnErrorRecovers) {
+  InlineExecutor executor;
+  bool ok_handler_ran = false;
+  Supplier<int> supplier = []() -> Result<int> {
+    return Status::Invalid("XYZ");
+  };
+  LazyFuture<int> fut(std::move(supplier), &executor);
+  LazyFuture<int> recovered =
+      std::move(fut)
+          .ThenOk<int>([](int val) { return val + 1; })
+          .OnError([](Status status) -> Result<int> {
+            EXPECT_TRUE(status.IsInvalid());
+            return 7;
+          })
+          .OnError([&](Status) -> Result<int> {
+            ok_handler_ran = true;
+            return 0;
+          })
+          .ThenOk<int>([](int val) { return val * 2; });
+
+  bool callback_ran = false;
+  std::move(recovered).ConsumeAsync([&](Result<int> val) {
+    callback_ran = true;
+    ASSERT_EQ(14, *val);
+  });
+  ASSERT_TRUE(callback_ran);
+  ASSERT_FALSE(ok_handler_ran);
+}
+
+TEST(LazyFutureTest, VoidThenOkAndOnError) {
+  InlineExecutor executor;
+  LazyFuture<void> fut([] { return Status::IOError("disk"); }, &executor);
+  LazyFuture<int> continued =
+      std::move(fut)
+          .OnError([](Status status) {
+            EXPECT_TRUE(status.IsIOError());
+            return Status::OK();
+          })
+          .ThenOk<int>([]() -> Result<int> { return 3; });
+
+  bool callback_ran = false;
+  std::move(continued).ConsumeAsync([&](Result<int> val) {
+    callback_ran = true;
+    ASSERT_EQ(3, *val);
+  });
+  ASSERT_TRUE(callback_ran);
+}
+
+TEST(LazyFutureTest, VoidErrorSkipsThenOk) {
+  InlineExecutor executor;
+  int calls = 0;
+  LazyFuture<void> fut([] { return Status::IOError("disk"); }, &executor);
+  LazyFuture<int> continued =
+      std::move(fut)
+          .ThenOk<int>([&]() -> Result<int> {
+            calls++;
+            return 1;
+          })
+          .ThenOk<int>([&](int val) {
+            calls++;
+            return val + 1;
+          });
+
+  bool callback_ran = false;
+  std::move(continued).ConsumeAsync([&](Result<int> val) {
+    callback_ran = true;
+    ASSERT_TRUE(val.status().IsIOError());
+  });
+  ASSERT_TRUE(callback_ran);
+  ASSERT_EQ(0, calls);
+}
+
+TEST(LazyFutureTest, LongVoidOnErrorChain) {
+  // Deep enough that nested compositions would exhaust the stack
+  constexpr int kNumSteps = 1000000;
+  InlineExecutor executor;
+  int calls = 0;
+  LazyFuture<void> fut([] { return Status::OK(); }, &executor);
+  for (int i = 0; i < kNumSteps; i++) {
+    fut = std::move(fut).OnError([&](Status status) {
+      calls++;
+      return status;
+    });
+  }
+
+  bool callback_ran = false;
+  std::move(fut).ConsumeAsync([&](Status status) {
+    callback_ran = true;
+    ASSERT_TRUE(status.ok());
+  });
+  ASSERT_TRUE(callback_ran);
+  ASSERT_EQ(0, calls);
+}
+
+TEST(LazyFutureTest, LongThenChain) {
+  // Deep enough that a recursive chain would exhaust the stack
+  constexpr int kNumSteps = 1000000;
+  InlineExecutor executor;
+  Supplier<int> supplier = []() -> Result<int> { return 0; };
+  LazyFuture<int> fut(std::move(supplier), &executor);
+  for (int i = 0; i < kNumSteps; i++) {
+    fut = std::move(fut).Then<int>(
+        [](Result<int> val) -> Result<int> { return *val + 1; });
+  }
+
+  bool callback_ran = false;
+  std::move(fut).ConsumeAsync([&](Result<int> val) {
+    callback_ran = true;
+    ASSERT_EQ(kNumSteps, *val);
+  });
+  ASSERT_TRUE(callback_ran);
+}
+
+TEST(LazyFutureTest, ThenChangesTypeAfterError) {
+  InlineExecutor executor;
+  Supplier<int> supplier = []() -> Result<int> { return 1; };
+  LazyFuture<std::string> fut =
+      LazyFuture<int>(std::move(supplier), &executor)
+          .ThenOk<std::shared_ptr<int>>(
+              [](int) -> Result<std::shared_ptr<int>> {
+                return Status::IOError("fail");
+              })
+          .ThenOk<int>([](std::shared_ptr<int> val) { return *val; })
+          .Then<std::string>([](Result<int> val) -> Result<std::string> {
+            EXPECT_TRUE(val.status().IsIOError());
+            return std::string("recovered");
+          });
+
+  bool callback_ran = false;
+  std::move(fut).ConsumeAsync([&](Result<std::string> val) {
+    callback_ran = true;
+    ASSERT_EQ("recovered", *val);
+  });
+  ASSERT_TRUE(callback_ran);
+}
+
+TEST(LazyFutureTest, ThreadPool) {
+  std::vector<int> values(8);
+  {
+    ThreadPoolExecutor executor(4);
+    for (int i = 0; i < 8; i++) {
+      Supplier<int> supplier = [i]() -> Result<int> { return i; };
+      LazyFuture<int> fut =
+          LazyFuture<int>(std::move(supplier), &executor)
+              .Then<int>(
+                  [](Result<int> val) -> Result<int> { return *val * 2; });
+      std::move(fut).ConsumeAsync(
+          [&values, i](Result<int> val) { values[i] = *val; });
+    }
+  }
+  for (int i = 0; i < 8; i++) {
+    ASSERT_EQ(i * 2, values[i]);
+  }
+}
+
+// Blocks the (single) worker of an executor until released so a test can
+// queue up several tasks before any of them run
+class BlockWorker {
+public:
+  explicit BlockWorker(Executor *executor) {
+    executor->Spawn([this] {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return released_; });
+    });
+  }
+  void Release() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      released_ = true;
+    }
+    cv_.notify_one();
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool released_ = false;
+};
+
+TEST(LazyFutureTest, Yield) {
+  std::vector<std::string> order;
+  {
+    ThreadPoolExecutor executor(1);
+    BlockWorker block(&executor);
+    Supplier<int> supplier = [&]() -> Result<int> {
+      order.push_back("a1");
+      return 0;
+    };
+    LazyFuture<int> fut = LazyFuture<int>(std::move(supplier), &executor)
+                              .Yield()
+                              .Then<int>([&](Result<int> val) {
+                                order.push_back("a2");
+                                return val;
+                              });
+    std::move(fut).ConsumeAsync([](Result<int>) {});
+    LazyFuture<void> other(
+        [&] {
+          order.push_back("b");
+          return Status::OK();
+        },
+        &executor);
+    std::move(other).ConsumeAsync([](Status) {});
+    block.Release();
+  }
+  ASSERT_EQ(std::vector<std::string>({"a1", "b", "a2"}), order);
+}
+
+TEST(LazyFutureTest, TimeSlice) {
+  constexpr int kNumSteps = 100;
+  std::vector<int> order;
+  {
+    TimeSlice time_slice;
+    time_slice.max_steps = 10;
+    ThreadPoolExecutor executor(1, time_slice);
+    BlockWorker block(&executor);
+    Supplier<int> supplier = []() -> Result<int> { return 0; };
+    LazyFuture<int> fut(std::move(supplier), &executor);
+    for (int i = 0; i < kNumSteps; i++) {
+      fut = std::move(fut).Then<int>(
+          [](Result<int> val) -> Result<int> { return *val + 1; });
+    }
+    std::move(fut).ConsumeAsync([&](Result<int> val) {
+      ASSERT_EQ(kNumSteps, *val);
+      order.push_back(1);
+    });
+    LazyFuture<void> other(
+        [&] {
+          order.push_back(2);
+          return Status::OK();
+        },
+        &executor);
+    std::move(other).ConsumeAsync([](Status) {});
+    block.Release();
+  }
+  // The short task should not have to wait for all steps of the long one
+  ASSERT_EQ(std::vector<int>({2, 1}), order);
+}
+
+TEST(LazyFutureTest, InlineOnCurrentExecutor) {
+  std::vector<std::string> order;
+  {
+    ThreadPoolExecutor executor(1);
+    LazyFuture<void> outer(
+        [&] {
+          EXPECT_EQ(&executor, Executor::Current());
+          LazyFuture<void> inner(
+              [&] {
+                order.push_back("inner");
+                return Status::OK();
+              },
+              &executor);
+          std::move(inner).ConsumeAsync([](Status) {});
+          order.push_back("outer");
+          return Status::OK();
+        },
+        &executor);
+    std::move(outer).ConsumeAsync([](Status) {});
+  }
+  ASSERT_EQ(nullptr, Executor::Current());
+  // Already on the executor so the inner future skipped the queue
+  ASSERT_EQ(std::vector<std::string>({"inner", "outer"}), order);
+}
+
+// Consumes a future whose consumer consumes another future, `remaining` deep
+void ConsumeRecursively(Executor *executor, int remaining, int *max_depth,
+                        int *completed) {
+  LazyFuture<void> fut([] { return Status::OK(); }, executor);
+  std::move(fut).ConsumeAsync([=](Status) {
+    *max_depth = std::max(*max_depth, internal::inline_depth);
+    if (remaining > 0) {
+      ConsumeRecursively(executor, remaining - 1, max_depth, completed);
+    }
+    (*completed)++;
+  });
+}
+
+TEST(LazyFutureTest, InlineDepthIsBounded) {
+  int max_depth = 0;
+  int completed = 0;
+  {
+    ThreadPoolExecutor executor(1);
+    executor.Spawn([&] {
+      ConsumeRecursively(&executor, 1000, &max_depth, &completed);
+    });
+  }
+  ASSERT_EQ(1001, completed);
+  ASSERT_EQ(kMaxInlineDepth, max_depth);
+}
+
+TEST(LazyFutureTest, Via) {
+  std::thread::id main_thread_id = std::this_thread::get_id();
+  std::thread::id ran_on;
+  {
+    InlineExecutor inline_executor;
+    ThreadPoolExecutor executor(1);
+    Supplier<int> supplier = [&]() -> Result<int> {
+      ran_on = std::this_thread::get_id();
+      return 1;
+    };
+    LazyFuture<int> fut(std::move(supplier), &inline_executor);
+    std::move(fut).Via(&executor).ConsumeAsync([](Result<int>) {});
+  }
+  ASSERT_NE(main_thread_id, ran_on);
+}
+
+// Counts how often instances are moved, copied and alive
+struct Tracked {
+  static inline int moves = 0;
+  static inline int copies = 0;
+  static inline int live = 0;
+  static void ResetCounts() { moves = copies = 0; }
+
+  explicit Tracked(int value, std::string name = "")
+      : value(value), name(std::move(name)) {
+    live++;
+  }
+  Tracked(Tracked &&other) noexcept
+      : value(other.value), name(std::move(other.name)) {
+    moves++;
+    live++;
+  }
+  Tracked(const Tracked &other) : value(other.value), name(other.name) {
+    copies++;
+    live++;
+  }
+  ~Tracked() { live--; }
+
+  int value;
+  std::string name;
+};
+
+TEST(ResultTest, InPlace) {
+  Tracked::ResetCounts();
+  {
+    Result<Tracked> result(std::in_place, 7, "seven");
+    ASSERT_TRUE(result.ok());
+    ASSERT_EQ(7, result->value);
+    ASSERT_EQ("seven", result->name);
+  }
+  ASSERT_EQ(0, Tracked::moves);
+  ASSERT_EQ(0, Tracked::copies);
+  ASSERT_EQ(0, Tracked::live);
+}
+
+TEST(LazyFutureTest, ThenEmplaceDoesNotMove) {
+  InlineExecutor executor;
+  Tracked::ResetCounts();
+  auto step = [](Tracked &&in, Emplacer<Tracked> &out) {
+    out.Emplace(in.value + 1, in.name);
+    return Status::OK();
+  };
+  std::optional<Result<Tracked>> out;
+  int moves_before_consumer = -1;
+  LazyFuture<Tracked>(
+      []() -> Result<Tracked> { return Result<Tracked>(std::in_place, 0); },
+      &executor)
+      .ThenEmplace<Tracked>(step)
+      .ThenEmplace<Tracked>(step)
+      .ThenEmplace<Tracked>(step)
+      .ThenEmplace<Tracked>(step)
+      .ThenEmplace<Tracked>(step)
+      .ConsumeAsync([&](Result<Tracked> result) {
+        moves_before_consumer = Tracked::moves;
+        out = std::move(result);
+      });
+  ASSERT_EQ(5, (*out)->value);
+  // Only taking the result out of the chain and handing it to the consumer
+  // move it, not the steps
+  ASSERT_LE(moves_before_consumer, 2);
+  ASSERT_EQ(0, Tracked::copies);
+  out.reset();
+  ASSERT_EQ(0, Tracked::live);
+}
+
+TEST(LazyFutureTest, ThenEmplaceErrors) {
+  InlineExecutor executor;
+  auto source = []() -> Result<Tracked> { return Tracked(1); };
+
+  // A failure after emplacing discards the output
+  std::optional<Status> status;
+  LazyFuture<Tracked>(source, &executor)
+      .ThenEmplace<Tracked>([](Tracked &&in, Emplacer<Tracked> &out) {
+        out.Emplace(in.value);
+        return Status::IOError("late failure");
+      })
+      .ConsumeAsync([&](Result<Tracked> result) { status = result.status(); });
+  ASSERT_TRUE(status->IsIOError());
+  ASSERT_EQ(0, Tracked::live);
+
+  LazyFuture<Tracked>(source, &executor)
+      .ThenEmplace<int>(
+          [](Tracked &&, Emplacer<int> &) { return Status::OK(); })
+      .ConsumeAsync([&](Result<int> result) { status = result.status(); });
+  ASSERT_TRUE(status->IsInvalid());
+
+  // Errors skip the continuation
+  bool ran = false;
+  LazyFuture<Tracked>([]() -> Result<Tracked> { return Status::Invalid("x"); },
+                      &executor)
+      .ThenEmplace<int>([&](Tracked &&, Emplacer<int> &out) {
+        ran = true;
+        out.Emplace(1);
+        return Status::OK();
+      })
+      .ConsumeAsync([&](Result<int> result) { status = result.status(); });
+  ASSERT_FALSE(ran);
+  ASSERT_EQ("x", status->message());
+  ASSERT_EQ(0, Tracked::live);
+}
+
+TEST(LazyFutureTest, ThenInPlaceDoesNotMove) {
+  InlineExecutor executor;
+  Tracked::ResetCounts();
+  auto step = [](Tracked &value) {
+    value.value++;
+    value.name += "+";
+    return Status::OK();
+  };
+  std::optional<Result<Tracked>> out;
+  int moves_before_consumer = -1;
+  LazyFuture<Tracked>(
+      []() -> Result<Tracked> { return Result<Tracked>(std::in_place, 0); },
+      &executor)
+      .ThenInPlace(step)
+      .ThenInPlace(step)
+      .ThenInPlace(step)
+      .ThenInPlace(step)
+      .ConsumeAsync([&](Result<Tracked> result) {
+        moves_before_consumer = Tracked::moves;
+        out = std::move(result);
+      });
+  ASSERT_EQ(4, (*out)->value);
+  ASSERT_EQ("++++", (*out)->name);
+  ASSERT_LE(moves_before_consumer, 2);
+  ASSERT_EQ(0, Tracked::copies);
+  out.reset();
+  ASSERT_EQ(0, Tracked::live);
+
+  // Mixed with steps that do produce a new Result
+  Result<int> mixed;
+  LazyFuture<int>([] { return 1; }, &executor)
+      .ThenInPlace([](int &x) {
+        x *= 10;
+        return Status::OK();
+      })
+      .ThenOk<int>([](int x) -> Result<int> { return x + 1; })
+      .ThenInPlace([](int &x) {
+        x *= 10;
+        return Status::OK();
+      })
+      .ThenOk<int>([](int x) -> Result<int> { return x + 1; })
+      .ConsumeAsync([&](Result<int> result) { mixed = std::move(result); });
+  ASSERT_EQ(111, *mixed);
+}
+
+TEST(LazyFutureTest, ThenInPlaceErrors) {
+  InlineExecutor executor;
+  Tracked::ResetCounts();
+  auto source = []() -> Result<Tracked> { return Tracked(1); };
+
+  // A failure discards the value and skips later in place steps
+  int ran = 0;
+  std::optional<Status> status;
+  LazyFuture<Tracked>(source, &executor)
+      .ThenInPlace([&](Tracked &) {
+        ran++;
+        return Status::IOError("failed");
+      })
+      .ThenInPlace([&](Tracked &) {
+        ran++;
+        return Status::OK();
+      })
+      .ConsumeAsync([&](Result<Tracked> result) { status = result.status(); });
+  ASSERT_TRUE(status->IsIOError());
+  ASSERT_EQ(1, ran);
+  ASSERT_EQ(0, Tracked::live);
+
+  // The chain can recover from the failure
+  Result<int> recovered;
+  LazyFuture<int>([] { return 1; }, &executor)
+      .ThenInPlace([](int &) { return Status::Invalid("x"); })
+      .OnError([](Status) -> Result<int> { return 5; })
+      .ThenInPlace([](int &x) {
+        x++;
+        return Status::OK();
+      })
+      .ConsumeAsync(
+          [&](Result<int> result) { recovered = std::move(result); });
+  ASSERT_EQ(6, *recovered);
+}
+
 } // namespace futures
\ No newline at end of file
@@ -0,0 +1,193 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+// Open-loop load generator
+//
+// Submits LazyFuture work to an executor at a fixed rate, or with Poisson
+// arrivals, regardless of how quickly earlier requests complete.  Latency is
+// measured from when each request was meant to start rather than when it was
+// actually submitted, so a generator that falls behind a saturated executor
+// still charges the queueing delay to the executor (coordinated omission
+// correction).
+//
+//   load_generator --executor=pool --threads=4 --rate=50000 --arrival=poisson
+//                  --duration=10 --work_us=20
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "future.h"
+#include "load_util.h"
+
+namespace futures {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct LoadOptions {
+  std::string executor = "pool";
+  int threads = 4;
+  double rate = 10000;
+  bool poisson = false;
+  double duration_s = 5;
+  int64_t work_us = 10;
+};
+
+// Simulated service time, spins so the worker is actually busy
+void Spin(std::chrono::microseconds work) {
+  const auto end = Clock::now() + work;
+  while (Clock::now() < end) {
+  }
+}
+
+bool ParseFlag(const char *arg, const char *name, std::string *value) {
+  const size_t length = std::strlen(name);
+  if (std::strncmp(arg, name, length) != 0 || arg[length] != '=') {
+    return false;
+  }
+  *value = arg + length + 1;
+  return true;
+}
+
+Status ParseOptions(int argc, char **argv, LoadOptions *options) {
+  for (int i = 1; i < argc; i++) {
+    std::string value;
+    if (ParseFlag(argv[i], "--executor", &value)) {
+      options->executor = value;
+    } else if (ParseFlag(argv[i], "--threads", &value)) {
+      options->threads = std::atoi(value.c_str());
+    } else if (ParseFlag(argv[i], "--rate", &value)) {
+      options->rate = std::atof(value.c_str());
+    } else if (ParseFlag(argv[i], "--arrival", &value)) {
+      if (value != "fixed" && value != "poisson") {
+        return Status::Invalid("--arrival must be fixed or poisson");
+      }
+      options->poisson = value == "poisson";
+    } else if (ParseFlag(argv[i], "--duration", &value)) {
+      options->duration_s = std::atof(value.c_str());
+    } else if (ParseFlag(argv[i], "--work_us", &value)) {
+      options->work_us = std::atoll(value.c_str());
+    } else {
+      return Status::Invalid("Unknown argument ", argv[i]);
+    }
+  }
+  if (options->rate <= 0 || options->threads <= 0) {
+    return Status::Invalid("--rate and --threads must be positive");
+  }
+  return Status::OK();
+}
+
+double Micros(std::chrono::nanoseconds duration) {
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+Status RunLoad(const LoadOptions &options) {
+  auto maybe_executor = MakeExecutor(options.executor, options.threads);
+  if (!maybe_executor.ok()) {
+    return maybe_executor.status();
+  }
+  std::shared_ptr<Executor> executor = std::move(maybe_executor).ValueOrDie();
+  LatencyHistogram latency;
+  LatencyHistogram submit_lag;
+  std::atomic<int64_t> completed{0};
+  int64_t submitted = 0;
+
+  std::mt19937_64 rng(42);
+  std::exponential_distribution<double> poisson_gap(options.rate);
+  const auto fixed_gap = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(1.0 / options.rate));
+  const auto work = std::chrono::microseconds(options.work_us);
+
+  const auto start = Clock::now();
+  const auto end = start + std::chrono::duration_cast<Clock::duration>(
+                               std::chrono::duration<double>(
+                                   options.duration_s));
+  auto intended = start;
+  while (intended < end) {
+    std::this_thread::sleep_until(intended);
+    submit_lag.Record(Clock::now() - intended);
+    LazyFuture<void>(
+        [work] {
+          Spin(work);
+          return Status::OK();
+        },
+        executor.get())
+        .ConsumeAsync([&latency, &completed, intended](Status) {
+          latency.Record(Clock::now() - intended);
+          completed.fetch_add(1, std::memory_order_release);
+        });
+    submitted++;
+    if (options.poisson) {
+      intended += std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<double>(poisson_gap(rng)));
+    } else {
+      intended += fixed_gap;
+    }
+  }
+  while (completed.load(std::memory_order_acquire) < submitted) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  const double elapsed_s =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::printf("executor=%s threads=%d arrival=%s rate=%.0f/s work=%lldus\n",
+              options.executor.c_str(), options.threads,
+              options.poisson ? "poisson" : "fixed", options.rate,
+              static_cast<long long>(options.work_us));
+  std::printf("requests=%lld achieved=%.0f/s\n",
+              static_cast<long long>(submitted),
+              static_cast<double>(submitted) / elapsed_s);
+  std::printf("%-12s %12s %12s %12s %12s %12s\n", "", "p50 (us)", "p90",
+              "p99", "p99.9", "max");
+  for (const auto &[name, histogram] :
+       {std::make_pair("latency", &latency),
+        std::make_pair("submit lag", &submit_lag)}) {
+    std::printf("%-12s %12.1f %12.1f %12.1f %12.1f %12.1f\n", name,
+                Micros(histogram->Percentile(50)),
+                Micros(histogram->Percentile(90)),
+                Micros(histogram->Percentile(99)),
+                Micros(histogram->Percentile(99.9)), Micros(histogram->Max()));
+  }
+  return Status::OK();
+}
+
+} // namespace
+
+} // namespace futures
+
+int main(int argc, char **argv) {
+  futures::LoadOptions options;
+  futures::Status status = futures::ParseOptions(argc, argv, &options);
+  if (status.ok()) {
+    status = futures::RunLoad(options);
+  }
+  if (!status.ok()) {
+    std::fprintf(stderr, "%s\n", status.ToString().c_str());
+    return 1;
+  }
+  return 0;
+}
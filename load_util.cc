@@ -0,0 +1,150 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "load_util.h"
+
+#include <algorithm>
+#include <bit>
+
+#include "adaptive_executor.h"
+#include "blocking.h"
+#include "fiber.h"
+#include "sharded_executor.h"
+
+namespace futures {
+
+namespace {
+
+constexpr int kSubBuckets = 16;
+
+int BucketIndex(uint64_t value) {
+  if (value < kSubBuckets) {
+    return static_cast<int>(value);
+  }
+  const int exponent = std::bit_width(value) - 1;
+  const int sub_bucket = static_cast<int>(value >> (exponent - 4)) & 15;
+  return (exponent - 3) * kSubBuckets + sub_bucket;
+}
+
+uint64_t BucketUpperBound(int index) {
+  if (index < kSubBuckets) {
+    return static_cast<uint64_t>(index);
+  }
+  const int exponent = index / kSubBuckets + 3;
+  const uint64_t sub_bucket = index % kSubBuckets;
+  const uint64_t width = uint64_t{1} << (exponent - 4);
+  return (kSubBuckets + sub_bucket) * width + width - 1;
+}
+
+// Keeps the executor an AdaptiveExecutor delegates to alive alongside it
+struct AdaptiveOverPool {
+  explicit AdaptiveOverPool(int num_threads)
+      : pool(num_threads), adaptive(&pool) {}
+  ThreadPoolExecutor pool;
+  AdaptiveExecutor adaptive;
+};
+
+} // namespace
+
+LatencyHistogram::LatencyHistogram()
+    : buckets_(new std::array<std::atomic<int64_t>, kNumBuckets>()) {
+  for (auto &bucket : *buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+void LatencyHistogram::Record(std::chrono::nanoseconds latency) {
+  const uint64_t value =
+      latency.count() < 0 ? 0 : static_cast<uint64_t>(latency.count());
+  (*buckets_)[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  int64_t max = max_.load(std::memory_order_relaxed);
+  while (static_cast<int64_t>(value) > max &&
+         !max_.compare_exchange_weak(max, static_cast<int64_t>(value),
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+int64_t LatencyHistogram::count() const {
+  int64_t total = 0;
+  for (const auto &bucket : *buckets_) {
+    total += bucket.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+std::chrono::nanoseconds LatencyHistogram::Percentile(double percentile) const {
+  const int64_t total = count();
+  if (total == 0) {
+    return std::chrono::nanoseconds(0);
+  }
+  const double rank = percentile / 100.0 * static_cast<double>(total);
+  int64_t seen = 0;
+  for (int i = 0; i < kNumBuckets; i++) {
+    seen += (*buckets_)[i].load(std::memory_order_relaxed);
+    if (static_cast<double>(seen) >= rank && seen > 0) {
+      return std::min(
+          std::chrono::nanoseconds(static_cast<int64_t>(BucketUpperBound(i))),
+          Max());
+    }
+  }
+  return Max();
+}
+
+std::chrono::nanoseconds LatencyHistogram::Max() const {
+  return std::chrono::nanoseconds(max_.load(std::memory_order_relaxed));
+}
+
+std::vector<std::string> ExecutorNames() {
+  std::vector<std::string> names = {"inline",  "pool",     "sharded",
+                                    "elastic", "adaptive"};
+#ifdef FUTURES_HAVE_FIBERS
+  names.push_back("fiber");
+#endif
+  return names;
+}
+
+Result<std::shared_ptr<Executor>> MakeExecutor(const std::string &name,
+                                               int num_threads) {
+  if (name == "inline") {
+    return std::shared_ptr<Executor>(std::make_shared<InlineExecutor>());
+  }
+  if (name == "pool") {
+    return std::shared_ptr<Executor>(
+        std::make_shared<ThreadPoolExecutor>(num_threads));
+  }
+  if (name == "sharded") {
+    return std::shared_ptr<Executor>(
+        std::make_shared<ShardedExecutor>(num_threads));
+  }
+  if (name == "elastic") {
+    return std::shared_ptr<Executor>(
+        std::make_shared<ElasticThreadPool>(num_threads));
+  }
+  if (name == "adaptive") {
+    auto owner = std::make_shared<AdaptiveOverPool>(num_threads);
+    return std::shared_ptr<Executor>(owner, &owner->adaptive);
+  }
+#ifdef FUTURES_HAVE_FIBERS
+  if (name == "fiber") {
+    return std::shared_ptr<Executor>(
+        std::make_shared<FiberExecutor>(num_threads));
+  }
+#endif
+  return Status::Invalid("Unknown executor '", name, "'");
+}
+
+} // namespace futures
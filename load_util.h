@@ -0,0 +1,71 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "future.h"
+#include "result.h"
+
+namespace futures {
+
+/// \brief A log-linear histogram of latencies that can be recorded into from
+/// many threads at once
+///
+/// Values are bucketed with 16 sub-buckets per power of two so reported
+/// percentiles are within about 6% of the true value.
+class LatencyHistogram {
+public:
+  LatencyHistogram();
+
+  void Record(std::chrono::nanoseconds latency);
+
+  int64_t count() const;
+  /// \brief The upper bound of the bucket holding the given percentile, e.g.
+  /// 99.9
+  std::chrono::nanoseconds Percentile(double percentile) const;
+  std::chrono::nanoseconds Max() const;
+
+private:
+  static constexpr int kSubBucketBits = 4;
+  static constexpr int kNumBuckets = 64 << kSubBucketBits;
+
+  std::unique_ptr<std::array<std::atomic<int64_t>, kNumBuckets>> buckets_;
+  std::atomic<int64_t> max_{0};
+};
+
+/// \brief The executors a load test can be pointed at
+///
+/// One of "inline", "pool", "sharded", "elastic", "adaptive" or "fiber" (the
+/// last only where fibers are supported).
+std::vector<std::string> ExecutorNames();
+
+/// \brief Create the named executor with `num_threads` workers
+///
+/// The executor to use is returned with anything it depends on kept alive by
+/// the same owner.
+Result<std::shared_ptr<Executor>> MakeExecutor(const std::string &name,
+                                               int num_threads);
+
+} // namespace futures
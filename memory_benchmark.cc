@@ -0,0 +1,237 @@
+#include <benchmark/benchmark.h>
+
+#include <malloc.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "future.h"
+
+// Every heap allocation in this binary is counted so the benchmarks can
+// report exactly how much memory an in-flight future holds on to
+static std::atomic<int64_t> heap_bytes{0};
+
+void *operator new(size_t size) {
+  void *ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  heap_bytes.fetch_add(malloc_usable_size(ptr), std::memory_order_relaxed);
+  return ptr;
+}
+
+void *operator new(size_t size, std::align_val_t align) {
+  void *ptr = std::aligned_alloc(static_cast<size_t>(align),
+                                 (size + static_cast<size_t>(align) - 1) /
+                                     static_cast<size_t>(align) *
+                                     static_cast<size_t>(align));
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  heap_bytes.fetch_add(malloc_usable_size(ptr), std::memory_order_relaxed);
+  return ptr;
+}
+
+// Shared by every delete overload.  Not inlined so that GCC does not see
+// free() paired with a new expression, and not operator delete(ptr) itself
+// since forwarding the sized and aligned overloads to it also trips
+// -Wmismatched-new-delete.
+__attribute__((noinline)) static void ReleaseTracked(void *ptr) {
+  if (ptr != nullptr) {
+    heap_bytes.fetch_sub(malloc_usable_size(ptr), std::memory_order_relaxed);
+    std::free(ptr);
+  }
+}
+
+void operator delete(void *ptr) noexcept { ReleaseTracked(ptr); }
+void operator delete(void *ptr, size_t) noexcept { ReleaseTracked(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept {
+  ReleaseTracked(ptr);
+}
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept {
+  ReleaseTracked(ptr);
+}
+
+namespace futures {
+
+namespace {
+
+int64_t ResidentBytes() {
+  long size = 0;
+  long resident = 0;
+  FILE *statm = std::fopen("/proc/self/statm", "r");
+  if (statm == nullptr) {
+    return 0;
+  }
+  if (std::fscanf(statm, "%ld %ld", &size, &resident) != 2) {
+    resident = 0;
+  }
+  std::fclose(statm);
+  return static_cast<int64_t>(resident) * sysconf(_SC_PAGESIZE);
+}
+
+// Heap and RSS taken at the start of a benchmark, reported per future once
+// all of them are in flight.  Take it after reserving any vectors holding the
+// futures, their inline size is added by Report instead.
+class Footprint {
+public:
+  Footprint() : heap_(heap_bytes.load()), rss_(ResidentBytes()) {}
+
+  void Report(benchmark::State &state, int64_t num_futures,
+              size_t inline_size) {
+    const double n = static_cast<double>(num_futures);
+    state.counters["bytes_per_future"] =
+        static_cast<double>(inline_size) +
+        static_cast<double>(heap_bytes.load() - heap_) / n;
+    state.counters["rss_per_future"] =
+        static_cast<double>(ResidentBytes() - rss_) / n;
+  }
+
+private:
+  int64_t heap_;
+  int64_t rss_;
+};
+
+void ReportTeardown(benchmark::State &state,
+                    std::chrono::steady_clock::time_point start) {
+  state.counters["teardown_ms"] =
+      std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - start)
+          .count();
+}
+
+LazyFuture<int> MakeChain(int i, Executor *executor) {
+  return LazyFuture<int>([i]() -> Result<int> { return i; }, executor)
+      .Then<int>([](Result<int> value) { return value; })
+      .Then<int>([](Result<int> value) { return value; });
+}
+
+// Occupies a single worker until released so work queues up behind it
+class BlockWorker {
+public:
+  explicit BlockWorker(Executor *executor) {
+    executor->Spawn([this] {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return released_; });
+    });
+  }
+
+  void Release() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    released_ = true;
+    cv_.notify_one();
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool released_ = false;
+};
+
+} // namespace
+
+// Chains that have been built but not consumed yet
+static void BM_PendingChains(benchmark::State &state) {
+  const int64_t num_futures = state.range(0);
+  InlineExecutor executor;
+  for (auto _ : state) {
+    std::vector<LazyFuture<int>> futures;
+    futures.reserve(num_futures);
+    Footprint footprint;
+    for (int64_t i = 0; i < num_futures; i++) {
+      futures.push_back(MakeChain(static_cast<int>(i), &executor));
+    }
+    footprint.Report(state, num_futures, sizeof(LazyFuture<int>));
+    const auto start = std::chrono::steady_clock::now();
+    futures.clear();
+    futures.shrink_to_fit();
+    ReportTeardown(state, start);
+  }
+}
+BENCHMARK(BM_PendingChains)
+    ->Arg(1 << 20)
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
+
+// Chains that have been consumed and are queued behind a busy worker
+static void BM_QueuedChains(benchmark::State &state) {
+  const int64_t num_futures = state.range(0);
+  for (auto _ : state) {
+    ThreadPoolExecutor executor(1);
+    BlockWorker blocker(&executor);
+    std::atomic<int64_t> completed{0};
+    Footprint footprint;
+    for (int64_t i = 0; i < num_futures; i++) {
+      MakeChain(static_cast<int>(i), &executor)
+          .ConsumeAsync([&completed](Result<int>) {
+            completed.fetch_add(1, std::memory_order_relaxed);
+          });
+    }
+    // Consumed futures are moved into their task frames, nothing inline
+    footprint.Report(state, num_futures, 0);
+    const auto start = std::chrono::steady_clock::now();
+    blocker.Release();
+    while (completed.load() < num_futures) {
+      std::this_thread::yield();
+    }
+    ReportTeardown(state, start);
+  }
+}
+BENCHMARK(BM_QueuedChains)
+    ->Arg(1 << 20)
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Futures whose value is filled in later by a producer through a shared slot,
+// the closest this tree has to a promise-backed future
+static void BM_PromiseBackedFutures(benchmark::State &state) {
+  const int64_t num_futures = state.range(0);
+  InlineExecutor executor;
+  using Slot = std::shared_ptr<Result<int>>;
+  for (auto _ : state) {
+    std::vector<Slot> slots;
+    std::vector<LazyFuture<int>> futures;
+    slots.reserve(num_futures);
+    futures.reserve(num_futures);
+    Footprint footprint;
+    for (int64_t i = 0; i < num_futures; i++) {
+      auto slot = std::make_shared<Result<int>>(Status::Cancelled("pending"));
+      futures.push_back(LazyFuture<int>(
+          [slot]() -> Result<int> { return std::move(*slot); }, &executor));
+      slots.push_back(std::move(slot));
+    }
+    footprint.Report(state, num_futures,
+                     sizeof(LazyFuture<int>) + sizeof(Slot));
+    for (int64_t i = 0; i < num_futures; i++) {
+      *slots[i] = static_cast<int>(i);
+      std::move(futures[i]).ConsumeAsync(
+          [](Result<int> value) { benchmark::DoNotOptimize(value); });
+    }
+    const auto start = std::chrono::steady_clock::now();
+    futures.clear();
+    futures.shrink_to_fit();
+    slots.clear();
+    slots.shrink_to_fit();
+    ReportTeardown(state, start);
+  }
+}
+BENCHMARK(BM_PromiseBackedFutures)
+    ->Arg(1 << 20)
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace futures
+
+BENCHMARK_MAIN();
@@ -0,0 +1,140 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "perf_counters.h"
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace futures {
+
+namespace {
+
+bool perf_counters_enabled = false;
+
+#ifdef __linux__
+
+struct PerfEvent {
+  const char *name;
+  uint32_t type;
+  uint64_t config;
+};
+
+constexpr uint64_t CacheMissConfig(uint64_t cache) {
+  return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+constexpr std::array<PerfEvent, kNumPerfEvents> kPerfEvents = {{
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"l1d_misses", PERF_TYPE_HW_CACHE,
+     CacheMissConfig(PERF_COUNT_HW_CACHE_L1D)},
+    {"llc_misses", PERF_TYPE_HW_CACHE, CacheMissConfig(PERF_COUNT_HW_CACHE_LL)},
+    {"dtlb_misses", PERF_TYPE_HW_CACHE,
+     CacheMissConfig(PERF_COUNT_HW_CACHE_DTLB)},
+}};
+
+int OpenPerfEvent(const PerfEvent &event) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = event.type;
+  attr.config = event.config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // There are usually fewer hardware counters than events so the kernel may
+  // multiplex them, the times let the counts be scaled back up
+  attr.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return static_cast<int>(
+      syscall(SYS_perf_event_open, &attr, /*pid=*/0, /*cpu=*/-1,
+              /*group_fd=*/-1, /*flags=*/0));
+}
+
+#endif
+
+} // namespace
+
+ScopedPerfCounters::ScopedPerfCounters(benchmark::State &state)
+    : state_(state) {
+  fds_.fill(-1);
+#ifdef __linux__
+  if (!perf_counters_enabled) {
+    return;
+  }
+  for (int i = 0; i < kNumPerfEvents; i++) {
+    fds_[i] = OpenPerfEvent(kPerfEvents[i]);
+  }
+  // Opening is slow, start them all together afterwards
+  for (int fd : fds_) {
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+#endif
+}
+
+ScopedPerfCounters::~ScopedPerfCounters() {
+#ifdef __linux__
+  for (int fd : fds_) {
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+  for (int i = 0; i < kNumPerfEvents; i++) {
+    if (fds_[i] < 0) {
+      continue;
+    }
+    uint64_t values[3];
+    if (read(fds_[i], values, sizeof(values)) == sizeof(values) &&
+        values[2] > 0) {
+      const double scaled = static_cast<double>(values[0]) *
+                            static_cast<double>(values[1]) /
+                            static_cast<double>(values[2]);
+      // Summed over threads then divided by the total iteration count
+      state_.counters[kPerfEvents[i].name] =
+          benchmark::Counter(scaled, benchmark::Counter::kAvgIterations);
+    }
+    close(fds_[i]);
+  }
+#endif
+}
+
+void ParsePerfCountersFlag(int *argc, char **argv) {
+  int kept = 1;
+  for (int i = 1; i < *argc; i++) {
+    if (std::strcmp(argv[i], "--perf_counters") == 0) {
+      perf_counters_enabled = true;
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  *argc = kept;
+}
+
+} // namespace futures
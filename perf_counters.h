@@ -0,0 +1,54 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <array>
+
+#include <benchmark/benchmark.h>
+
+namespace futures {
+
+constexpr int kNumPerfEvents = 6;
+
+/// \brief Counts hardware events on the calling thread for the lifetime of the
+/// scope and reports them per iteration as user counters on `state`
+///
+/// Reports cycles, instructions, branch_misses, l1d_misses, llc_misses and
+/// dtlb_misses.  Does nothing unless enabled with --perf_counters, and skips
+/// any event the kernel or hardware won't provide (e.g. in a VM, or with a
+/// perf_event_paranoid setting above 2).  Only the benchmark thread is
+/// counted, not executor workers.
+///
+/// Create it after any setup, right before the `for (auto _ : state)` loop.
+class ScopedPerfCounters {
+public:
+  explicit ScopedPerfCounters(benchmark::State &state);
+  ~ScopedPerfCounters();
+  ScopedPerfCounters(const ScopedPerfCounters &) = delete;
+  ScopedPerfCounters &operator=(const ScopedPerfCounters &) = delete;
+
+private:
+  benchmark::State &state_;
+  std::array<int, kNumPerfEvents> fds_;
+};
+
+/// \brief Remove --perf_counters from the command line, enabling counters if
+/// it was there.  Call before benchmark::Initialize.
+void ParsePerfCountersFlag(int *argc, char **argv);
+
+} // namespace futures
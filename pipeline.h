@@ -0,0 +1,261 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "future.h"
+#include "result_batch.h"
+
+namespace futures {
+
+template <typename In, typename Mid, typename Out, typename Front,
+          typename Segment>
+class Pipeline;
+
+namespace internal {
+
+template <typename T> struct IsLazyFuture : std::false_type {};
+template <typename T> struct IsLazyFuture<LazyFuture<T>> : std::true_type {
+  using ValueType = T;
+};
+
+// A synchronous segment is a nest of stages.  Each stage is called with an
+// item and `emit`, the rest of the segment, so a whole segment inlines into
+// one function per item.  Stages return the item's error, or OK if it was
+// emitted or filtered out.
+struct IdentityStage {
+  template <typename T, typename Emit>
+  Status operator()(T &&item, Emit &&emit) {
+    return emit(std::forward<T>(item));
+  }
+};
+
+template <typename Prev, typename Fn> struct MapStage {
+  template <typename T, typename Emit>
+  Status operator()(T &&item, Emit &&emit) {
+    return prev(std::forward<T>(item), [&](auto &&value) -> Status {
+      using R = std::invoke_result_t<Fn &, decltype(value)>;
+      if constexpr (std::is_same_v<R, typename EnsureResult<R>::type>) {
+        R mapped = fn(std::forward<decltype(value)>(value));
+        if (!mapped.ok()) [[unlikely]] {
+          return mapped.status();
+        }
+        return emit(mapped.MoveValueUnsafe());
+      } else {
+        return emit(fn(std::forward<decltype(value)>(value)));
+      }
+    });
+  }
+  Prev prev;
+  Fn fn;
+};
+
+template <typename Prev, typename Pred> struct FilterStage {
+  template <typename T, typename Emit>
+  Status operator()(T &&item, Emit &&emit) {
+    return prev(std::forward<T>(item), [&](auto &&value) -> Status {
+      if (!pred(std::as_const(value))) {
+        return Status::OK();
+      }
+      return emit(std::forward<decltype(value)>(value));
+    });
+  }
+  Prev prev;
+  Pred pred;
+};
+
+// Runs a segment as one Then step
+template <typename T, typename V, typename Segment> struct SegmentTask {
+  Result<std::optional<V>> operator()(T item) {
+    std::optional<V> out;
+    Status status = segment(std::move(item), [&](auto &&value) {
+      out.emplace(std::forward<decltype(value)>(value));
+      return Status::OK();
+    });
+    if (!status.ok()) [[unlikely]] {
+      return status;
+    }
+    return out;
+  }
+  Segment segment;
+};
+
+template <typename T> struct PipelineDone {
+  void Fail(Status status) { consumer(std::move(status)); }
+  void Skip() { consumer(std::optional<T>()); }
+  Consumer<std::optional<T>> consumer;
+};
+
+// The part of a pipeline with no async stages before the first segment
+struct DirectFront {
+  template <typename F, typename Next, typename Done>
+  void operator()(F future, Next &&next, Done &&) {
+    next(std::move(future));
+  }
+};
+
+// Everything up to and including an async stage: runs the previous fronts,
+// then the segment before the stage fused into one Then, then the stage,
+// handing the future it returns to `next`
+template <typename Mid, typename X, typename Front, typename Segment,
+          typename Fn>
+struct AsyncFront {
+  template <typename F, typename Next, typename Done>
+  void operator()(F future, Next next, Done done) {
+    front(
+        std::move(future),
+        [segment = segment, fn = fn, next = std::move(next),
+         done](LazyFuture<Mid> mid) mutable {
+          std::move(mid)
+              .template ThenOk<std::optional<X>>(
+                  SegmentTask<Mid, X, Segment>{std::move(segment)})
+              .ConsumeAsync([fn = std::move(fn), next = std::move(next),
+                             done](Result<std::optional<X>> item) mutable {
+                if (!item.ok()) {
+                  done.Fail(item.status());
+                } else if (!item->has_value()) {
+                  done.Skip();
+                } else {
+                  next(fn(std::move(**item)));
+                }
+              });
+        },
+        done);
+  }
+  Front front;
+  Segment segment;
+  Fn fn;
+};
+
+} // namespace internal
+
+/// \brief Stateless per-item operators over a stream of futures, fused at
+/// compile time
+///
+/// Adjacent synchronous stages (Map with a function returning a value or a
+/// Result, and Filter) are nested into one callable that the compiler can
+/// inline, and run as a single Then step per item however many there are.
+/// A Map whose function returns a LazyFuture ends the segment: the item
+/// waits for that future and the stages after it form the next segment.
+///
+/// Items are delivered as optionals, nullopt meaning an item was filtered
+/// out.  Errors skip the remaining stages.  Start with MakePipeline.
+template <typename In, typename Mid, typename Out, typename Front,
+          typename Segment>
+class Pipeline {
+public:
+  using InputType = In;
+  using OutputType = Out;
+
+  /// \brief True if no stage returns a future
+  static constexpr bool kSynchronous =
+      std::is_same_v<Front, internal::DirectFront>;
+
+  Pipeline(Front front, Segment segment)
+      : front_(std::move(front)), segment_(std::move(segment)) {}
+
+  /// \brief Add a stage applying fn to each item
+  ///
+  /// fn may return a value, a Result or a LazyFuture.
+  template <typename Fn> auto Map(Fn fn) && {
+    using R = std::invoke_result_t<Fn &, Out>;
+    if constexpr (internal::IsLazyFuture<R>::value) {
+      using V = typename internal::IsLazyFuture<R>::ValueType;
+      using NextFront = internal::AsyncFront<Mid, Out, Front, Segment, Fn>;
+      return Pipeline<In, V, V, NextFront, internal::IdentityStage>(
+          NextFront{std::move(front_), std::move(segment_), std::move(fn)},
+          internal::IdentityStage{});
+    } else {
+      using V = typename EnsureResult<R>::type::ValueType;
+      using NextSegment = internal::MapStage<Segment, Fn>;
+      return Pipeline<In, Mid, V, Front, NextSegment>(
+          std::move(front_), NextSegment{std::move(segment_), std::move(fn)});
+    }
+  }
+
+  /// \brief Add a stage dropping items for which pred returns false
+  template <typename Pred> auto Filter(Pred pred) && {
+    using NextSegment = internal::FilterStage<Segment, Pred>;
+    return Pipeline<In, Mid, Out, Front, NextSegment>(
+        std::move(front_), NextSegment{std::move(segment_), std::move(pred)});
+  }
+
+  /// \brief Run `input` through the pipeline and pass the item to consumer
+  void Consume(LazyFuture<In> input, Consumer<std::optional<Out>> consumer) {
+    internal::PipelineDone<Out> done{std::move(consumer)};
+    front_(
+        std::move(input),
+        [segment = segment_, done](LazyFuture<Mid> mid) mutable {
+          std::move(mid)
+              .template ThenOk<std::optional<Out>>(
+                  internal::SegmentTask<Mid, Out, Segment>{std::move(segment)})
+              .ConsumeAsync(std::move(done.consumer));
+        },
+        done);
+  }
+
+  /// \brief `input` with the whole pipeline added as one Then step
+  LazyFuture<std::optional<Out>> Apply(LazyFuture<In> input) const {
+    static_assert(kSynchronous, "Apply needs a pipeline without futures, "
+                                "use Consume");
+    return std::move(input).template ThenOk<std::optional<Out>>(
+        internal::SegmentTask<In, Out, Segment>{segment_});
+  }
+
+  /// \brief Run every OK item of a batch through the pipeline
+  ///
+  /// Filtered items are left out of the output, errors keep their place.
+  ResultBatch<Out> ApplyToBatch(ResultBatch<In> batch) {
+    static_assert(kSynchronous, "ApplyToBatch needs a pipeline without "
+                                "futures");
+    ResultBatch<Out> out;
+    out.Reserve(batch.size());
+    auto errors = batch.errors();
+    auto values = batch.mutable_values();
+    size_t next_error = 0;
+    for (int64_t i = 0; i < batch.size(); i++) {
+      if (next_error < errors.size() && errors[next_error].first == i) {
+        out.AppendError(errors[next_error++].second);
+        continue;
+      }
+      Status status = segment_(std::move(values[i]), [&](auto &&value) {
+        out.AppendValue(std::forward<decltype(value)>(value));
+        return Status::OK();
+      });
+      if (!status.ok()) [[unlikely]] {
+        out.AppendError(std::move(status));
+      }
+    }
+    return out;
+  }
+
+private:
+  Front front_;
+  Segment segment_;
+};
+
+/// \brief An empty pipeline over items of type T
+template <typename T> auto MakePipeline() {
+  return Pipeline<T, T, T, internal::DirectFront, internal::IdentityStage>(
+      internal::DirectFront{}, internal::IdentityStage{});
+}
+
+} // namespace futures
@@ -0,0 +1,154 @@
+#include <condition_variable>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "batch_stream.h"
+#include "future.h"
+#include "pipeline.h"
+
+namespace futures {
+
+// Runs `input` through `pipeline` and waits for the item
+template <typename P, typename T>
+Result<std::optional<typename P::OutputType>>
+ConsumeAndWait(P &pipeline, LazyFuture<T> input) {
+  using Out = typename P::OutputType;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::optional<Result<std::optional<Out>>> done;
+  pipeline.Consume(std::move(input), [&](Result<std::optional<Out>> item) {
+    std::lock_guard<std::mutex> lock(mutex);
+    done = std::move(item);
+    cv.notify_one();
+  });
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&] { return done.has_value(); });
+  return std::move(*done);
+}
+
+TEST(PipelineTest, FusesSynchronousStages) {
+  InlineExecutor executor;
+  auto pipeline = MakePipeline<int>()
+                      .Map([](int x) { return x * 2; })
+                      .Filter([](int x) { return x % 3 != 0; })
+                      .Map([](int x) { return std::to_string(x); });
+  static_assert(decltype(pipeline)::kSynchronous);
+  static_assert(
+      std::is_same_v<std::string, decltype(pipeline)::OutputType>);
+
+  std::optional<Result<std::optional<std::string>>> out;
+  pipeline.Apply(LazyFuture<int>([] { return 5; }, &executor))
+      .ConsumeAsync([&](Result<std::optional<std::string>> item) {
+        out = std::move(item);
+      });
+  ASSERT_EQ("10", ***out);
+
+  out.reset();
+  pipeline.Apply(LazyFuture<int>([] { return 6; }, &executor))
+      .ConsumeAsync([&](Result<std::optional<std::string>> item) {
+        out = std::move(item);
+      });
+  ASSERT_TRUE(out->ok());
+  ASSERT_FALSE((*out)->has_value());
+}
+
+TEST(PipelineTest, ErrorsSkipRemainingStages) {
+  InlineExecutor executor;
+  int reached = 0;
+  auto pipeline = MakePipeline<int>()
+                      .Map([](int x) -> Result<int> {
+                        if (x < 0) {
+                          return Status::Invalid("negative ", x);
+                        }
+                        return x;
+                      })
+                      .Map([&](int x) {
+                        reached++;
+                        return x;
+                      });
+  auto item = ConsumeAndWait(
+      pipeline, LazyFuture<int>([] { return -4; }, &executor));
+  ASSERT_EQ("negative -4", item.status().message());
+  item = ConsumeAndWait(
+      pipeline,
+      LazyFuture<int>([]() -> Result<int> { return Status::IOError("x"); },
+                      &executor));
+  ASSERT_TRUE(item.status().IsIOError());
+  ASSERT_EQ(0, reached);
+  item = ConsumeAndWait(pipeline,
+                        LazyFuture<int>([] { return 4; }, &executor));
+  ASSERT_EQ(4, **item);
+  ASSERT_EQ(1, reached);
+}
+
+TEST(PipelineTest, AsyncBoundaries) {
+  ThreadPoolExecutor pool(2);
+  InlineExecutor executor;
+  auto pipeline =
+      MakePipeline<int>()
+          .Map([](int x) { return x + 1; })
+          .Map([&pool](int x) {
+            return LazyFuture<int>([x] { return x * 10; }, &pool);
+          })
+          .Filter([](int x) { return x != 30; })
+          .Map([&pool](int x) {
+            return LazyFuture<std::string>(
+                [x] { return std::string(x / 10, '+'); }, &pool);
+          })
+          .Map([](std::string s) { return s + "!"; });
+  static_assert(!decltype(pipeline)::kSynchronous);
+
+  auto item =
+      ConsumeAndWait(pipeline, LazyFuture<int>([] { return 3; }, &executor));
+  ASSERT_EQ("++++!", **item);
+  item =
+      ConsumeAndWait(pipeline, LazyFuture<int>([] { return 2; }, &executor));
+  ASSERT_TRUE(item.ok());
+  ASSERT_FALSE(item->has_value());
+}
+
+TEST(PipelineTest, PipeBatchStream) {
+  InlineExecutor executor;
+  std::vector<int> items(1000);
+  std::iota(items.begin(), items.end(), 0);
+  BatchOptions options;
+  options.batch_size = 128;
+  auto stream =
+      BatchStream<int>::FromVector(std::move(items), &executor, options)
+          .Pipe(MakePipeline<int>()
+                    .Filter([](int x) { return x % 2 == 0; })
+                    .Map([](int x) -> Result<int64_t> {
+                      if (x == 500) {
+                        return Status::Invalid("500");
+                      }
+                      return int64_t{x} * 3;
+                    }));
+  int64_t sum = 0;
+  int64_t count = 0;
+  int64_t errors = 0;
+  Status status;
+  std::move(stream).Visit(
+      [&](const ResultBatch<int64_t> &batch) {
+        errors += batch.error_count();
+        for (int64_t i = 0; i < batch.size(); i++) {
+          if (batch.IsOk(i)) {
+            sum += batch.value(i);
+            count++;
+          }
+        }
+        return Status::OK();
+      },
+      [&](Status st) { status = std::move(st); });
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(499, count);
+  ASSERT_EQ(1, errors);
+  ASSERT_EQ(3 * (499 * 500 - 500), sum);
+}
+
+} // namespace futures
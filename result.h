@@ -84,7 +84,8 @@ public:
   template <bool CanMemcpy = can_memcpy>
   static typename std::enable_if<CanMemcpy>::type
   move_construct_several(AlignedStorage *ARROW_RESTRICT src,
-                         AlignedStorage *ARROW_RESTRICT dest, size_t n,
+                         AlignedStorage *ARROW_RESTRICT dest,
+                         [[maybe_unused]] size_t n,
                          size_t memcpy_length) noexcept {
     memcpy(dest->get(), src->get(), memcpy_length * sizeof(T));
   }
@@ -93,7 +94,7 @@ public:
   static typename std::enable_if<CanMemcpy>::type
   move_construct_several_and_destroy_source(AlignedStorage *ARROW_RESTRICT src,
                                             AlignedStorage *ARROW_RESTRICT dest,
-                                            size_t n,
+                                            [[maybe_unused]] size_t n,
                                             size_t memcpy_length) noexcept {
     memcpy(dest->get(), src->get(), memcpy_length * sizeof(T));
   }
@@ -102,7 +103,7 @@ public:
   static typename std::enable_if<!CanMemcpy>::type
   move_construct_several(AlignedStorage *ARROW_RESTRICT src,
                          AlignedStorage *ARROW_RESTRICT dest, size_t n,
-                         size_t memcpy_length) noexcept {
+                         [[maybe_unused]] size_t memcpy_length) noexcept {
     for (size_t i = 0; i < n; ++i) {
       new (dest[i].get()) T(std::move(*src[i].get()));
     }
@@ -113,7 +114,8 @@ public:
   move_construct_several_and_destroy_source(AlignedStorage *ARROW_RESTRICT src,
                                             AlignedStorage *ARROW_RESTRICT dest,
                                             size_t n,
-                                            size_t memcpy_length) noexcept {
+                                            [[maybe_unused]] size_t
+                                                memcpy_length) noexcept {
     for (size_t i = 0; i < n; ++i) {
       new (dest[i].get()) T(std::move(*src[i].get()));
       src[i].destroy();
@@ -285,6 +287,17 @@ public:
     ConstructValue(std::move(value));
   }
 
+  /// Constructs a Result object whose value is constructed in place from
+  /// `args`, without a temporary `T` to move from.
+  ///
+  /// \param args The arguments to pass to the constructor of `T`.
+  template <typename... A,
+            typename E = typename std::enable_if<
+                std::is_constructible<T, A &&...>::value>::type>
+  explicit Result(std::in_place_t, A &&...args) noexcept {
+    ConstructValue(std::forward<A>(args)...);
+  }
+
   /// Copy constructor.
   ///
   /// This constructor needs to be explicitly defined because the presence of
@@ -346,7 +359,9 @@ public:
   Result(Result<U> &&other) noexcept {
     if (other.status_.ok()) [[likely]] {
       status_ = std::move(other.status_);
-      ConstructValue(other.MoveValueUnsafe());
+      // Move straight from the storage, MoveValueUnsafe would add a second
+      // move through its return value
+      ConstructValue(std::move(*other.storage_.get()));
     } else {
       // If we moved the status, the other status may become ok but the other
       // value hasn't been constructed => crash on other destructor.
@@ -368,7 +383,7 @@ public:
     Destroy();
     if (other.status_.ok()) [[likely]] {
       status_ = std::move(other.status_);
-      ConstructValue(other.MoveValueUnsafe());
+      ConstructValue(std::move(*other.storage_.get()));
     } else {
       // If we moved the status, the other status may become ok but the other
       // value hasn't been constructed => crash on other destructor.
@@ -543,8 +558,8 @@ private:
   Status status_; // pointer-sized
   internal::AlignedStorage<T> storage_;
 
-  template <typename U> void ConstructValue(U &&u) noexcept {
-    storage_.construct(std::forward<U>(u));
+  template <typename... A> void ConstructValue(A &&...args) noexcept {
+    storage_.construct(std::forward<A>(args)...);
   }
 
   void Destroy() noexcept {
@@ -0,0 +1,168 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "result.h"
+#include "status.h"
+
+namespace futures {
+
+/// \brief A column of results: the values in one contiguous array, a
+/// validity bitmap and the error statuses off to the side
+///
+/// Compared to `std::vector<Result<T>>` there is no Status next to every
+/// value, so numeric values can be processed with SIMD and errors counted
+/// with a popcount over the bitmap.  Errors are assumed to be rare and are
+/// kept in a side table sorted by index.
+///
+/// The value at an error's index is a default-constructed T.
+template <typename T> class ResultBatch {
+  static_assert(std::is_default_constructible_v<T>,
+                "ResultBatch needs a value to put in place of errors");
+  // std::vector<bool> is packed and cannot be viewed as a span of values
+  static_assert(!std::is_same_v<T, bool>,
+                "ResultBatch<bool> is not supported, use uint8_t instead");
+
+public:
+  ResultBatch() = default;
+
+  static ResultBatch FromResults(std::vector<Result<T>> results) {
+    ResultBatch batch;
+    batch.Reserve(static_cast<int64_t>(results.size()));
+    for (auto &result : results) {
+      batch.Append(std::move(result));
+    }
+    return batch;
+  }
+
+  void Reserve(int64_t capacity) {
+    values_.reserve(capacity);
+    validity_.reserve((capacity + 63) / 64);
+  }
+
+  void Append(Result<T> result) {
+    if (result.ok()) {
+      AppendValue(std::move(result).MoveValueUnsafe());
+    } else {
+      AppendError(std::move(result).status());
+    }
+  }
+
+  void AppendValue(T value) {
+    values_.push_back(std::move(value));
+    AppendValidity(true);
+  }
+
+  void AppendError(Status status) {
+    errors_.emplace_back(size(), std::move(status));
+    values_.emplace_back();
+    AppendValidity(false);
+  }
+
+  int64_t size() const { return static_cast<int64_t>(values_.size()); }
+  bool empty() const { return values_.empty(); }
+
+  bool IsOk(int64_t i) const { return (validity_[i / 64] >> (i % 64)) & 1; }
+
+  /// \brief The number of errors, a popcount over the bitmap
+  int64_t error_count() const {
+    int64_t ok_count = 0;
+    for (uint64_t word : validity_) {
+      ok_count += std::popcount(word);
+    }
+    return size() - ok_count;
+  }
+
+  /// \brief All values, including placeholders where there are errors
+  std::span<const T> values() const { return values_; }
+  std::span<T> mutable_values() { return values_; }
+
+  /// \brief Bit i of word i / 64 is set if result i is OK, bits past size()
+  /// are clear
+  std::span<const uint64_t> validity_bitmap() const { return validity_; }
+
+  /// \brief The errors and their indices, in index order
+  std::span<const std::pair<int64_t, Status>> errors() const {
+    return errors_;
+  }
+
+  const T &value(int64_t i) const { return values_[i]; }
+
+  Status status(int64_t i) const {
+    if (IsOk(i)) {
+      return Status::OK();
+    }
+    auto it = std::lower_bound(
+        errors_.begin(), errors_.end(), i,
+        [](const std::pair<int64_t, Status> &error, int64_t index) {
+          return error.first < index;
+        });
+    return it->second;
+  }
+
+  /// \brief The first error, or OK if there is none, like folding the
+  /// statuses with operator&
+  Status status() const {
+    return errors_.empty() ? Status::OK() : errors_.front().second;
+  }
+
+  Result<T> Get(int64_t i) const {
+    if (IsOk(i)) {
+      return values_[i];
+    }
+    return status(i);
+  }
+
+  std::vector<Result<T>> ToResults() && {
+    std::vector<Result<T>> results;
+    results.reserve(values_.size());
+    auto error = errors_.begin();
+    for (int64_t i = 0; i < size(); i++) {
+      if (IsOk(i)) {
+        results.emplace_back(std::move(values_[i]));
+      } else {
+        results.emplace_back(std::move(error->second));
+        ++error;
+      }
+    }
+    return results;
+  }
+
+private:
+  void AppendValidity(bool ok) {
+    const int64_t i = size() - 1;
+    if (i % 64 == 0) {
+      validity_.push_back(0);
+    }
+    validity_.back() |= static_cast<uint64_t>(ok) << (i % 64);
+  }
+
+  std::vector<T> values_;
+  std::vector<uint64_t> validity_;
+  std::vector<std::pair<int64_t, Status>> errors_;
+};
+
+} // namespace futures
@@ -0,0 +1,78 @@
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "future.h"
+#include "result_batch.h"
+
+namespace futures {
+
+TEST(ResultBatchTest, ValuesBitmapAndErrors) {
+  ResultBatch<int> batch;
+  for (int i = 0; i < 100; i++) {
+    if (i % 30 == 7) {
+      batch.AppendError(Status::Invalid("bad ", i));
+    } else {
+      batch.AppendValue(i);
+    }
+  }
+  ASSERT_EQ(100, batch.size());
+  ASSERT_EQ(4, batch.error_count());
+  ASSERT_EQ(2, batch.validity_bitmap().size());
+  ASSERT_EQ(4, batch.errors().size());
+  ASSERT_TRUE(batch.IsOk(0));
+  ASSERT_FALSE(batch.IsOk(37));
+  ASSERT_EQ(0, batch.value(37));
+  ASSERT_EQ(99, batch.value(99));
+  ASSERT_EQ("bad 37", batch.status(37).message());
+  ASSERT_TRUE(batch.status(38).ok());
+  ASSERT_EQ("bad 7", batch.status().message());
+  ASSERT_EQ(Status::Invalid("bad 67"), batch.Get(67).status());
+  ASSERT_EQ(68, *batch.Get(68));
+}
+
+TEST(ResultBatchTest, RoundTrip) {
+  std::vector<Result<int>> results = {1, Status::IOError("x"), 3};
+  auto batch = ResultBatch<int>::FromResults(results);
+  ASSERT_EQ(1, batch.error_count());
+  ASSERT_EQ(results, std::move(batch).ToResults());
+  ASSERT_TRUE(ResultBatch<int>().status().ok());
+  ASSERT_EQ(0, ResultBatch<int>().error_count());
+}
+
+TEST(ResultBatchTest, CollectBatch) {
+  ThreadPoolExecutor pool(1);
+  std::vector<LazyFuture<int>> futures;
+  for (int i = 0; i < 10; i++) {
+    futures.push_back(
+        LazyFuture<int>([i]() -> Result<int> { return i; }, &pool)
+            .Then<int>([](Result<int> value) -> Result<int> {
+              if (*value == 4) {
+                return Status::Invalid("four");
+              }
+              return *value * 10;
+            }));
+  }
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool done = false;
+  ResultBatch<int> batch;
+  CollectBatch(std::move(futures), &pool)
+      .ConsumeAsync([&](Result<ResultBatch<int>> result) {
+        std::lock_guard<std::mutex> lock(mutex);
+        batch = std::move(result).MoveValueUnsafe();
+        done = true;
+        cv.notify_one();
+      });
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&] { return done; });
+  ASSERT_EQ(10, batch.size());
+  ASSERT_EQ(1, batch.error_count());
+  ASSERT_EQ(90, batch.value(9));
+  ASSERT_EQ("four", batch.status(4).message());
+}
+
+} // namespace futures
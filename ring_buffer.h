@@ -0,0 +1,155 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "result.h"
+
+namespace futures {
+
+/// \brief A growable FIFO in one power-of-two sized array
+///
+/// Unlike std::deque there is a single allocation, which is only replaced
+/// when the buffer grows.  Growing moves the (at most two) contiguous runs
+/// of elements with AlignedStorage's bulk moves, a memcpy for trivial types.
+template <typename T> class RingBuffer {
+public:
+  RingBuffer() = default;
+  RingBuffer(const RingBuffer &) = delete;
+  RingBuffer &operator=(const RingBuffer &) = delete;
+  RingBuffer(RingBuffer &&other) noexcept
+      : data_(std::exchange(other.data_, nullptr)),
+        capacity_(std::exchange(other.capacity_, 0)),
+        head_(std::exchange(other.head_, 0)),
+        size_(std::exchange(other.size_, 0)) {}
+  RingBuffer &operator=(RingBuffer &&other) noexcept {
+    if (this != &other) {
+      Release();
+      data_ = std::exchange(other.data_, nullptr);
+      capacity_ = std::exchange(other.capacity_, 0);
+      head_ = std::exchange(other.head_, 0);
+      size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+  }
+  ~RingBuffer() { Release(); }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  size_t capacity() const { return capacity_; }
+
+  /// \brief The i'th element from the front
+  T &operator[](size_t i) { return *slot(i).get(); }
+  const T &operator[](size_t i) const { return *slot(i).get(); }
+  T &front() { return (*this)[0]; }
+  const T &front() const { return (*this)[0]; }
+  T &back() { return (*this)[size_ - 1]; }
+  const T &back() const { return (*this)[size_ - 1]; }
+
+  template <typename... A> T &emplace_back(A &&...args) {
+    if (size_ == capacity_) [[unlikely]] {
+      // Construct first, `args` may refer to an element of this buffer
+      Grow(size_ + 1, [&](Storage *storage) {
+        storage->construct(std::forward<A>(args)...);
+      });
+    } else {
+      slot(size_).construct(std::forward<A>(args)...);
+    }
+    return *slot(size_++).get();
+  }
+  void push_back(const T &value) { emplace_back(value); }
+  void push_back(T &&value) { emplace_back(std::move(value)); }
+
+  void pop_front() {
+    data_[head_].destroy();
+    head_ = (head_ + 1) & (capacity_ - 1);
+    size_--;
+  }
+
+  void clear() {
+    if constexpr (std::is_trivially_destructible_v<T>) {
+      size_ = 0;
+    }
+    while (!empty()) {
+      pop_front();
+    }
+    head_ = 0;
+  }
+
+  /// \brief Make room for at least `n` elements without growing again
+  void reserve(size_t n) {
+    if (n > capacity_) {
+      Grow(n, [](Storage *) {});
+    }
+  }
+
+private:
+  using Storage = internal::AlignedStorage<T>;
+
+  static constexpr size_t kMinCapacity = 8;
+
+  Storage &slot(size_t i) const {
+    return data_[(head_ + i) & (capacity_ - 1)];
+  }
+
+  // Moves the elements to a larger array, calling `construct_last` with the
+  // slot after them before the old array is released
+  template <typename ConstructLast>
+  void Grow(size_t min_capacity, ConstructLast &&construct_last) {
+    size_t capacity = std::max(capacity_ * 2, kMinCapacity);
+    while (capacity < min_capacity) {
+      capacity *= 2;
+    }
+    Storage *data = std::allocator<Storage>().allocate(capacity);
+    construct_last(data + size_);
+    if (data_ != nullptr) {
+      // The elements from head_ to the end of the array, then any that
+      // wrapped around to the start
+      const size_t first = std::min(size_, capacity_ - head_);
+      Storage::move_construct_several_and_destroy_source(data_ + head_, data,
+                                                         first);
+      Storage::move_construct_several_and_destroy_source(data_, data + first,
+                                                         size_ - first);
+      std::allocator<Storage>().deallocate(data_, capacity_);
+    }
+    data_ = data;
+    capacity_ = capacity;
+    head_ = 0;
+  }
+
+  void Release() {
+    if (data_ != nullptr) {
+      clear();
+      std::allocator<Storage>().deallocate(data_, capacity_);
+      data_ = nullptr;
+      capacity_ = 0;
+    }
+  }
+
+  Storage *data_ = nullptr;
+  size_t capacity_ = 0;
+  size_t head_ = 0;
+  size_t size_ = 0;
+};
+
+} // namespace futures
@@ -0,0 +1,68 @@
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+#include "ring_buffer.h"
+
+namespace futures {
+
+TEST(RingBufferTest, FifoAcrossWrapAndGrowth) {
+  RingBuffer<int> buffer;
+  int next_in = 0;
+  int next_out = 0;
+  // Leave the head part way through the array so growing has to unwrap
+  for (int i = 0; i < 6; i++) {
+    buffer.push_back(next_in++);
+  }
+  for (int i = 0; i < 4; i++) {
+    ASSERT_EQ(next_out++, buffer.front());
+    buffer.pop_front();
+  }
+  for (int i = 0; i < 100; i++) {
+    buffer.push_back(next_in++);
+  }
+  ASSERT_EQ(102u, buffer.size());
+  ASSERT_EQ(128u, buffer.capacity());
+  ASSERT_EQ(next_out + 50, buffer[50]);
+  ASSERT_EQ(next_in - 1, buffer.back());
+  while (!buffer.empty()) {
+    ASSERT_EQ(next_out++, buffer.front());
+    buffer.pop_front();
+  }
+  ASSERT_EQ(next_in, next_out);
+}
+
+TEST(RingBufferTest, NonTrivialElements) {
+  RingBuffer<std::unique_ptr<std::string>> buffer;
+  for (int i = 0; i < 5; i++) {
+    buffer.push_back(std::make_unique<std::string>(std::to_string(i)));
+  }
+  buffer.pop_front();
+  buffer.pop_front();
+  for (int i = 5; i < 40; i++) {
+    buffer.emplace_back(new std::string(std::to_string(i)));
+  }
+  RingBuffer<std::unique_ptr<std::string>> moved = std::move(buffer);
+  ASSERT_TRUE(buffer.empty());
+  ASSERT_EQ(38u, moved.size());
+  for (int i = 2; i < 40; i++) {
+    ASSERT_EQ(std::to_string(i), *moved.front());
+    moved.pop_front();
+  }
+}
+
+TEST(RingBufferTest, PushOwnElementWhileGrowing) {
+  RingBuffer<std::string> buffer;
+  buffer.reserve(8);
+  for (int i = 0; i < 8; i++) {
+    buffer.push_back(std::string(100, 'a' + i));
+  }
+  ASSERT_EQ(8u, buffer.capacity());
+  buffer.push_back(buffer.front());
+  ASSERT_EQ(9u, buffer.size());
+  ASSERT_EQ(std::string(100, 'a'), buffer.back());
+}
+
+} // namespace futures
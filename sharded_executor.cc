@@ -0,0 +1,224 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "sharded_executor.h"
+
+#include <cstddef>
+#include <utility>
+
+#include "small_vector.h"
+
+namespace futures {
+
+class ShardedExecutor::Shard : public Executor {
+public:
+  Shard(ShardedExecutor *owner, int worker) : worker(worker), owner_(owner) {}
+
+  void Spawn(Task task) override {
+    owner_->SpawnOnShard(this, std::move(task));
+  }
+
+  // Only called from this shard's own tasks.  Running a nested future inline
+  // while earlier tasks wait would run it out of spawn order.
+  bool CanRunInline() override {
+    if (turn_remaining > 0) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    return tasks.empty();
+  }
+
+  // Tasks of the running turn that have not started yet, only touched by the
+  // worker running the shard
+  size_t turn_remaining = 0;
+
+  // Guards everything below
+  std::mutex mutex;
+  RingBuffer<Task> tasks;
+  // True while the shard is queued on, or being run by, its worker
+  bool scheduled = false;
+  int worker;
+
+private:
+  ShardedExecutor *owner_;
+};
+
+struct ShardedExecutor::Worker {
+  std::mutex mutex;
+  std::condition_variable shards_ready;
+  RingBuffer<Shard *> shards;
+  // Number of shards queued on this worker, read without the lock when
+  // balancing
+  std::atomic<int> load{0};
+  std::thread thread;
+};
+
+namespace {
+
+// Keys are often small sequential ids so mix them before taking a modulus
+// (the splitmix64 finalizer)
+uint64_t MixKey(uint64_t key) {
+  key ^= key >> 30;
+  key *= 0xbf58476d1ce4e5b9ULL;
+  key ^= key >> 27;
+  key *= 0x94d049bb133111ebULL;
+  key ^= key >> 31;
+  return key;
+}
+
+} // namespace
+
+ShardedExecutor::ShardedExecutor(int num_workers, ShardingOptions options)
+    : balance_(options.balance) {
+  const int num_shards =
+      options.num_shards > 0 ? options.num_shards : num_workers * 16;
+  shards_.reserve(num_shards);
+  for (int i = 0; i < num_shards; i++) {
+    shards_.push_back(std::make_unique<Shard>(this, i % num_workers));
+  }
+  workers_.reserve(num_workers);
+  for (int i = 0; i < num_workers; i++) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  for (auto &worker : workers_) {
+    Worker *worker_ptr = worker.get();
+    worker->thread =
+        std::thread([this, worker_ptr] { WorkerLoop(worker_ptr); });
+  }
+}
+
+ShardedExecutor::~ShardedExecutor() {
+  stopping_ = true;
+  for (auto &worker : workers_) {
+    std::lock_guard<std::mutex> lock(worker->mutex);
+    worker->shards_ready.notify_all();
+  }
+  for (auto &worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+void ShardedExecutor::Spawn(Task task) {
+  SpawnOnShard(shards_[next_unkeyed_++ % shards_.size()].get(),
+               std::move(task));
+}
+
+void ShardedExecutor::Spawn(uint64_t key, Task task) {
+  SpawnOnShard(ShardFor(key), std::move(task));
+}
+
+Executor *ShardedExecutor::ForKey(uint64_t key) { return ShardFor(key); }
+
+ShardedExecutor::Shard *ShardedExecutor::ShardFor(uint64_t key) {
+  return shards_[MixKey(key) % shards_.size()].get();
+}
+
+void ShardedExecutor::SpawnOnShard(Shard *shard, Task task) {
+  pending_tasks_++;
+  {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    shard->tasks.push_back(std::move(task));
+    if (shard->scheduled) {
+      return;
+    }
+    shard->scheduled = true;
+    if (balance_) {
+      // The shard is idle so it can move without breaking per-key ordering
+      Worker *home = workers_[shard->worker].get();
+      for (int i = 0; i < static_cast<int>(workers_.size()); i++) {
+        if (workers_[i]->load < home->load - 1) {
+          shard->worker = i;
+          home = workers_[i].get();
+        }
+      }
+    }
+  }
+  Schedule(shard);
+}
+
+void ShardedExecutor::Schedule(Shard *shard) {
+  // Only the thread that set shard->scheduled gets here so reading the
+  // worker without the shard lock is safe
+  Worker *worker = workers_[shard->worker].get();
+  {
+    std::lock_guard<std::mutex> lock(worker->mutex);
+    worker->shards.push_back(shard);
+    worker->load++;
+  }
+  worker->shards_ready.notify_one();
+}
+
+void ShardedExecutor::FinishTask() {
+  if (--pending_tasks_ == 0 && stopping_) {
+    for (auto &worker : workers_) {
+      std::lock_guard<std::mutex> lock(worker->mutex);
+      worker->shards_ready.notify_all();
+    }
+  }
+}
+
+void ShardedExecutor::WorkerLoop(Worker *worker) {
+  while (true) {
+    Shard *shard;
+    {
+      std::unique_lock<std::mutex> lock(worker->mutex);
+      worker->shards_ready.wait(lock, [&] {
+        return !worker->shards.empty() || (stopping_ && pending_tasks_ == 0);
+      });
+      if (worker->shards.empty()) {
+        return;
+      }
+      shard = worker->shards.front();
+      worker->shards.pop_front();
+      worker->load--;
+    }
+
+    // Take the whole turn's tasks under one lock.  The shard stays scheduled
+    // while they run so no other worker can pick up its later tasks.
+    SmallVector<Task, kTasksPerTurn> turn;
+    {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      while (turn.size() < static_cast<size_t>(kTasksPerTurn) &&
+             !shard->tasks.empty()) {
+        turn.push_back(std::move(shard->tasks.front()));
+        shard->tasks.pop_front();
+      }
+    }
+    SetCurrent(shard);
+    shard->turn_remaining = turn.size();
+    for (Task &task : turn) {
+      shard->turn_remaining--;
+      std::move(task)();
+      FinishTask();
+    }
+    SetCurrent(nullptr);
+    bool more_tasks;
+    {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      more_tasks = !shard->tasks.empty();
+      if (!more_tasks) {
+        shard->scheduled = false;
+      }
+    }
+    if (more_tasks) {
+      // Let the worker's other shards have a turn
+      Schedule(shard);
+    }
+  }
+}
+
+} // namespace futures
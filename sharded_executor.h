@@ -0,0 +1,89 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "future.h"
+#include "ring_buffer.h"
+
+namespace futures {
+
+struct ShardingOptions {
+  /// Number of shards keys are hashed to, 0 for 16 per worker
+  int num_shards = 0;
+  /// If true a shard that has gone idle may be moved to a less busy worker
+  /// the next time it receives work.  Busy shards never move, so tasks for
+  /// one key still run one at a time and in order.
+  bool balance = false;
+};
+
+/// \brief Runs all tasks for a key serially on the same worker thread
+///
+/// Keys are hashed to a fixed set of shards and each shard is owned by one
+/// worker.  Tasks of one shard never run concurrently and run in the order
+/// they were spawned, so per-key state needs no locking and stays in that
+/// worker's cache.
+///
+/// Queued tasks are drained before the destructor returns.
+class ShardedExecutor : public Executor {
+public:
+  explicit ShardedExecutor(int num_workers, ShardingOptions options = {});
+  virtual ~ShardedExecutor();
+
+  /// \brief Spawn a task with no key, spread across the shards
+  void Spawn(Task task) override;
+  /// \brief Spawn a task on the shard for `key`
+  void Spawn(uint64_t key, Task task);
+
+  /// \brief An executor that runs everything on the shard for `key`
+  ///
+  /// Use this as the executor of futures that touch per-key state.  The
+  /// returned executor lives as long as this one.
+  Executor *ForKey(uint64_t key);
+
+  int num_shards() const { return static_cast<int>(shards_.size()); }
+
+private:
+  class Shard;
+  struct Worker;
+
+  // Batch size before a busy shard goes to the back of its worker's queue
+  static constexpr int kTasksPerTurn = 32;
+
+  Shard *ShardFor(uint64_t key);
+  void SpawnOnShard(Shard *shard, Task task);
+  void Schedule(Shard *shard);
+  void FinishTask();
+  void WorkerLoop(Worker *worker);
+
+  const bool balance_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<uint64_t> next_unkeyed_{0};
+  std::atomic<int64_t> pending_tasks_{0};
+  std::atomic<bool> stopping_{false};
+};
+
+} // namespace futures
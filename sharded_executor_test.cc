@@ -0,0 +1,130 @@
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "future.h"
+#include "sharded_executor.h"
+
+namespace futures {
+
+struct KeyState {
+  int counter = 0;
+  std::vector<int> seen;
+  std::thread::id thread_id;
+  bool moved_thread = false;
+};
+
+void SpawnPerKeyWork(ShardedExecutor *executor, std::vector<KeyState> *keys,
+                     int tasks_per_key) {
+  for (int i = 0; i < tasks_per_key; i++) {
+    for (uint64_t key = 0; key < keys->size(); key++) {
+      KeyState *state = &(*keys)[key];
+      executor->Spawn(key, [state, i] {
+        // No locking, tasks for one key never run concurrently
+        state->counter++;
+        state->seen.push_back(i);
+        if (state->thread_id == std::thread::id()) {
+          state->thread_id = std::this_thread::get_id();
+        } else if (state->thread_id != std::this_thread::get_id()) {
+          state->moved_thread = true;
+        }
+      });
+    }
+  }
+}
+
+TEST(ShardedExecutorTest, SerialPerKey) {
+  constexpr int kTasksPerKey = 1000;
+  std::vector<KeyState> keys(16);
+  {
+    ShardedExecutor executor(4);
+    SpawnPerKeyWork(&executor, &keys, kTasksPerKey);
+  }
+  for (const auto &state : keys) {
+    ASSERT_EQ(kTasksPerKey, state.counter);
+    ASSERT_FALSE(state.moved_thread);
+    for (int i = 0; i < kTasksPerKey; i++) {
+      ASSERT_EQ(i, state.seen[i]);
+    }
+  }
+}
+
+TEST(ShardedExecutorTest, BalancedKeepsOrder) {
+  constexpr int kTasksPerKey = 1000;
+  std::vector<KeyState> keys(16);
+  {
+    ShardingOptions options;
+    options.num_shards = 8;
+    options.balance = true;
+    ShardedExecutor executor(4, options);
+    SpawnPerKeyWork(&executor, &keys, kTasksPerKey);
+  }
+  for (const auto &state : keys) {
+    ASSERT_EQ(kTasksPerKey, state.counter);
+    for (int i = 0; i < kTasksPerKey; i++) {
+      ASSERT_EQ(i, state.seen[i]);
+    }
+  }
+}
+
+TEST(ShardedExecutorTest, FuturesForKey) {
+  std::vector<int> results;
+  {
+    ShardedExecutor executor(4);
+    for (int i = 0; i < 10; i++) {
+      Supplier<int> supplier = [i]() -> Result<int> { return i; };
+      LazyFuture<int> fut(std::move(supplier), executor.ForKey(42));
+      std::move(fut)
+          .Then<int>([](Result<int> val) -> Result<int> { return *val * 2; })
+          .ConsumeAsync([&](Result<int> val) { results.push_back(*val); });
+    }
+  }
+  ASSERT_EQ(std::vector<int>({0, 2, 4, 6, 8, 10, 12, 14, 16, 18}), results);
+}
+
+TEST(ShardedExecutorTest, NestedFutureKeepsOrder) {
+  std::vector<std::string> order;
+  {
+    ShardedExecutor executor(2);
+    Executor *shard = executor.ForKey(7);
+    shard->Spawn([&] {
+      // Both queue behind this task, so "b" is waiting when "a" runs
+      shard->Spawn([&] {
+        order.push_back("a");
+        LazyFuture<void> nested(
+            [&] {
+              order.push_back("nested");
+              return Status::OK();
+            },
+            shard);
+        std::move(nested).ConsumeAsync([](Status) {});
+      });
+      shard->Spawn([&] { order.push_back("b"); });
+    });
+  }
+  ASSERT_EQ(std::vector<std::string>({"a", "b", "nested"}), order);
+}
+
+TEST(ShardedExecutorTest, NestedFutureRunsInlineWhenIdle) {
+  std::vector<std::string> order;
+  {
+    ShardedExecutor executor(2);
+    Executor *shard = executor.ForKey(7);
+    shard->Spawn([&] {
+      LazyFuture<void> nested(
+          [&] {
+            order.push_back("nested");
+            return Status::OK();
+          },
+          shard);
+      std::move(nested).ConsumeAsync([](Status) {});
+      order.push_back("after");
+    });
+  }
+  ASSERT_EQ(std::vector<std::string>({"nested", "after"}), order);
+}
+
+} // namespace futures
@@ -0,0 +1,151 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "result.h"
+
+namespace futures {
+
+/// \brief A vector that keeps up to N elements inline before allocating
+///
+/// Moving the elements (when growing, or moving a vector whose elements are
+/// inline) uses AlignedStorage's bulk moves, a memcpy for trivial types.
+/// A vector whose elements are on the heap is moved by stealing the pointer.
+template <typename T, size_t N> class SmallVector {
+public:
+  static_assert(N > 0, "use std::vector for no inline elements");
+
+  SmallVector() = default;
+  SmallVector(const SmallVector &other) { *this = other; }
+  SmallVector(SmallVector &&other) noexcept { *this = std::move(other); }
+  SmallVector &operator=(const SmallVector &other) {
+    if (this != &other) {
+      clear();
+      reserve(other.size_);
+      for (size_t i = 0; i < other.size_; i++) {
+        data_[i].construct(other[i]);
+      }
+      size_ = other.size_;
+    }
+    return *this;
+  }
+  SmallVector &operator=(SmallVector &&other) noexcept {
+    if (this != &other) {
+      clear();
+      if (!other.is_inline()) {
+        Release();
+        data_ = std::exchange(other.data_, other.inline_);
+        capacity_ = std::exchange(other.capacity_, N);
+      } else {
+        // Our own heap array, if any, is kept as it is large enough
+        Storage::move_construct_several_and_destroy_source(other.data_, data_,
+                                                           other.size_);
+      }
+      size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+  }
+  ~SmallVector() {
+    clear();
+    Release();
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  size_t capacity() const { return capacity_; }
+
+  T *data() { return data_->get(); }
+  const T *data() const { return data_->get(); }
+  T *begin() { return data(); }
+  T *end() { return data() + size_; }
+  const T *begin() const { return data(); }
+  const T *end() const { return data() + size_; }
+
+  T &operator[](size_t i) { return *data_[i].get(); }
+  const T &operator[](size_t i) const { return *data_[i].get(); }
+  T &front() { return (*this)[0]; }
+  const T &front() const { return (*this)[0]; }
+  T &back() { return (*this)[size_ - 1]; }
+  const T &back() const { return (*this)[size_ - 1]; }
+
+  template <typename... A> T &emplace_back(A &&...args) {
+    if (size_ == capacity_) [[unlikely]] {
+      // Construct first, `args` may refer to an element of this vector
+      Grow(size_ + 1, [&](Storage *storage) {
+        storage->construct(std::forward<A>(args)...);
+      });
+    } else {
+      data_[size_].construct(std::forward<A>(args)...);
+    }
+    return *data_[size_++].get();
+  }
+  void push_back(const T &value) { emplace_back(value); }
+  void push_back(T &&value) { emplace_back(std::move(value)); }
+
+  void pop_back() { data_[--size_].destroy(); }
+
+  void clear() {
+    Storage::destroy_several(data_, size_);
+    size_ = 0;
+  }
+
+  /// \brief Make room for at least `n` elements without growing again
+  void reserve(size_t n) {
+    if (n > capacity_) {
+      Grow(n, [](Storage *) {});
+    }
+  }
+
+private:
+  using Storage = internal::AlignedStorage<T>;
+
+  bool is_inline() const { return data_ == inline_; }
+
+  // Moves the elements to a larger heap array, calling `construct_last` with
+  // the slot after them before the old array is released
+  template <typename ConstructLast>
+  void Grow(size_t min_capacity, ConstructLast &&construct_last) {
+    const size_t capacity = std::max(capacity_ * 2, min_capacity);
+    Storage *data = std::allocator<Storage>().allocate(capacity);
+    construct_last(data + size_);
+    Storage::move_construct_several_and_destroy_source(data_, data, size_);
+    Release();
+    data_ = data;
+    capacity_ = capacity;
+  }
+
+  void Release() {
+    if (!is_inline()) {
+      std::allocator<Storage>().deallocate(data_, capacity_);
+      data_ = inline_;
+      capacity_ = N;
+    }
+  }
+
+  Storage *data_ = inline_;
+  size_t size_ = 0;
+  size_t capacity_ = N;
+  Storage inline_[N];
+};
+
+} // namespace futures
@@ -0,0 +1,74 @@
+#include <string>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+#include "result.h"
+#include "small_vector.h"
+#include "status.h"
+
+namespace futures {
+
+TEST(SmallVectorTest, InlineThenHeap) {
+  SmallVector<int, 4> vec;
+  const int *inline_data = vec.data();
+  for (int i = 0; i < 4; i++) {
+    vec.push_back(i);
+  }
+  ASSERT_EQ(inline_data, vec.data());
+  vec.push_back(4);
+  ASSERT_NE(inline_data, vec.data());
+  ASSERT_EQ(5u, vec.size());
+  ASSERT_EQ(8u, vec.capacity());
+  int expected = 0;
+  for (int value : vec) {
+    ASSERT_EQ(expected++, value);
+  }
+  vec.pop_back();
+  ASSERT_EQ(3, vec.back());
+}
+
+TEST(SmallVectorTest, MoveAndCopy) {
+  SmallVector<std::string, 2> small;
+  small.emplace_back("a");
+  SmallVector<std::string, 2> large;
+  for (int i = 0; i < 10; i++) {
+    large.push_back(std::string(50, 'a' + i));
+  }
+
+  // Heap elements are stolen, inline ones moved
+  const std::string *large_data = large.data();
+  SmallVector<std::string, 2> moved_large = std::move(large);
+  ASSERT_EQ(large_data, moved_large.data());
+  ASSERT_TRUE(large.empty());
+  SmallVector<std::string, 2> moved_small = std::move(small);
+  ASSERT_EQ("a", moved_small[0]);
+  ASSERT_TRUE(small.empty());
+
+  SmallVector<std::string, 2> copy = moved_large;
+  ASSERT_EQ(10u, copy.size());
+  ASSERT_EQ(std::string(50, 'j'), copy[9]);
+  copy = moved_small;
+  ASSERT_EQ(1u, copy.size());
+  ASSERT_EQ("a", copy.front());
+}
+
+TEST(SmallVectorTest, GrowResults) {
+  SmallVector<Result<std::string>, 4> results;
+  for (int i = 0; i < 100; i++) {
+    if (i % 7 == 0) {
+      results.push_back(Status::Invalid("bad ", i));
+    } else {
+      results.push_back(std::to_string(i));
+    }
+  }
+  // Pushing an element of the vector itself while it has to grow
+  results.reserve(results.size());
+  results.push_back(results[1]);
+  ASSERT_EQ(101u, results.size());
+  ASSERT_EQ("bad 98", results[98].status().message());
+  ASSERT_EQ("99", *results[99]);
+  ASSERT_EQ("1", *results.back());
+}
+
+} // namespace futures
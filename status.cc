@@ -1,8 +1,10 @@
 #include "status.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <sstream>
+#include <system_error>
 
 namespace futures {
 
@@ -16,6 +18,15 @@ StringStreamWrapper::~StringStreamWrapper() {}
 
 std::string StringStreamWrapper::str() { return sstream_->str(); }
 
+void StringBuilderBuffer::AppendToHeap(std::string_view text) {
+  if (!on_heap_) {
+    heap_.reserve(2 * (size_ + text.size()));
+    heap_.assign(stack_, size_);
+    on_heap_ = true;
+  }
+  heap_.append(text);
+}
+
 }  // namespace detail
 }  // namespace util
 
@@ -109,10 +120,38 @@ std::string Status::ToString() const {
   }
   result += ": ";
   result += state_->msg;
+  if (state_->error_number != 0) {
+    result += " [errno ";
+    result += std::to_string(state_->error_number);
+    result += ": ";
+    result += std::generic_category().message(state_->error_number);
+    result += "]";
+  }
+  if (state_->subcode != 0) {
+    result += " [subcode ";
+    result += std::to_string(state_->subcode);
+    result += "]";
+  }
+  if (state_->retryable) {
+    result += " [retryable]";
+  }
   if (state_->detail != nullptr) {
     result += ". Detail: ";
     result += state_->detail->ToString();
   }
+  for (const ErrorContext& context : this->context()) {
+    result += "\n";
+    result += context.file;
+    result += ":";
+    result += std::to_string(context.line);
+    result += "  ";
+    result += context.expr;
+  }
+  if (state_->num_context > kMaxErrorContext) {
+    result += "\n(";
+    result += std::to_string(state_->num_context - kMaxErrorContext);
+    result += " more)";
+  }
 
   return result;
 }
@@ -128,13 +167,36 @@ void Status::Abort(const std::string& message) const {
   std::abort();
 }
 
-#ifdef ARROW_EXTRA_ERROR_CONTEXT
+void Status::AddContext(const char* expr, std::source_location location) {
+  if (ok()) {
+    Abort("Cannot add context line to ok status");
+  }
+  if (state_->num_context < kMaxErrorContext) {
+    state_->context[state_->num_context] = {location.file_name(),
+                                            location.function_name(),
+                                            location.line(), expr};
+  }
+  state_->num_context++;
+}
+
 void Status::AddContextLine(const char* filename, int line, const char* expr) {
-  ARROW_CHECK(!ok()) << "Cannot add context line to ok status";
-  std::stringstream ss;
-  ss << "\n" << filename << ":" << line << "  " << expr;
-  state_->msg += ss.str();
+  if (ok()) {
+    Abort("Cannot add context line to ok status");
+  }
+  if (state_->num_context < kMaxErrorContext) {
+    state_->context[state_->num_context] = {
+        filename, "", static_cast<uint_least32_t>(line), expr};
+  }
+  state_->num_context++;
+}
+
+std::span<const ErrorContext> Status::context() const {
+  if (ok()) {
+    return {};
+  }
+  const size_t num_kept =
+      std::min<size_t>(state_->num_context, kMaxErrorContext);
+  return {state_->context.data(), num_kept};
 }
-#endif
 
 }  // namespace futures
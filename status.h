@@ -14,10 +14,17 @@
 
 #pragma once
 
+#include <array>
+#include <charconv>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <memory>
+#include <source_location>
+#include <span>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <utility>
 
 #ifdef ARROW_EXTRA_ERROR_CONTEXT
@@ -26,8 +33,8 @@
 #define ARROW_RETURN_IF_(condition, status, expr)                              \
   do {                                                                         \
     if (ARROW_PREDICT_FALSE(condition)) {                                      \
-      ::arrow::Status _st = (status);                                          \
-      _st.AddContextLine(__FILE__, __LINE__, expr);                            \
+      ::futures::Status _st = (status);                                        \
+      _st.AddContext(expr);                                                    \
       return _st;                                                              \
     }                                                                          \
   } while (0)
@@ -49,13 +56,13 @@
 /// \brief Propagate any non-successful Status to the caller
 #define ARROW_RETURN_NOT_OK(status)                                            \
   do {                                                                         \
-    ::arrow::Status __s = ::arrow::internal::GenericToStatus(status);          \
-    ARROW_RETURN_IF_(!__s.ok(), __s, ARROW_STRINGIFY(status));                 \
+    ::futures::Status __s = ::futures::internal::GenericToStatus(status);      \
+    ARROW_RETURN_IF_(!__s.ok(), std::move(__s), ARROW_STRINGIFY(status));      \
   } while (false)
 
 #define RETURN_NOT_OK_ELSE(s, else_)                                           \
   do {                                                                         \
-    ::arrow::Status _s = ::arrow::internal::GenericToStatus(s);                \
+    ::futures::Status _s = ::futures::internal::GenericToStatus(s);            \
     if (!_s.ok()) {                                                            \
       else_;                                                                   \
       return _s;                                                               \
@@ -67,8 +74,10 @@
 #define RETURN_NOT_OK(s) ARROW_RETURN_NOT_OK(s)
 #endif
 
-#define ARROW_PREDICT_FALSE(x) ([[unlikely]] x)
-#define ARROW_PREDICT_TRUE(x) ([[likely]] x)
+#define ARROW_STRINGIFY(x) #x
+#define ARROW_CONCAT(x, y) x##y
+#define ARROW_PREDICT_FALSE(x) (__builtin_expect(!!(x), 0))
+#define ARROW_PREDICT_TRUE(x) (__builtin_expect(!!(x), 1))
 #define ARROW_RESTRICT __restrict
 #define ARROW_NORETURN __attribute__((noreturn))
 #define ARROW_NOINLINE __attribute__((noinline))
@@ -145,23 +154,81 @@ protected:
   std::ostream &ostream_;
 };
 
-} // namespace detail
+/// \brief Accumulates a message on the stack, moving to the heap only once
+/// it outgrows kInlineSize
+class StringBuilderBuffer {
+public:
+  static constexpr size_t kInlineSize = 256;
+
+  void Append(std::string_view text) {
+    if (!on_heap_ && size_ + text.size() <= kInlineSize) [[likely]] {
+      std::memcpy(stack_ + size_, text.data(), text.size());
+      size_ += text.size();
+      return;
+    }
+    AppendToHeap(text);
+  }
 
-template <typename Head>
-void StringBuilderRecursive(std::ostream &stream, Head &&head) {
-  stream << head;
+  std::string str() && {
+    return on_heap_ ? std::move(heap_) : std::string(stack_, size_);
+  }
+
+private:
+  void AppendToHeap(std::string_view text);
+
+  bool on_heap_ = false;
+  size_t size_ = 0;
+  char stack_[kInlineSize];
+  std::string heap_;
+};
+
+template <typename T> constexpr bool IsCharacter() {
+  return std::is_same_v<T, char> || std::is_same_v<T, signed char> ||
+         std::is_same_v<T, unsigned char>;
 }
 
-template <typename Head, typename... Tail>
-void StringBuilderRecursive(std::ostream &stream, Head &&head, Tail &&...tail) {
-  StringBuilderRecursive(stream, std::forward<Head>(head));
-  StringBuilderRecursive(stream, std::forward<Tail>(tail)...);
+/// \brief Append `value` formatted the way `std::ostream << value` would with
+/// default flags, without touching the locale for the common types
+template <typename T>
+void StringBuilderAppend(StringBuilderBuffer *buffer, const T &value) {
+  using Decayed = std::decay_t<T>;
+  if constexpr (std::is_same_v<T, const char *> ||
+                std::is_same_v<T, char *>) {
+    // A stream writes nothing for a null string
+    if (value != nullptr) {
+      buffer->Append(value);
+    }
+  } else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+    buffer->Append(std::string_view(value));
+  } else if constexpr (std::is_same_v<Decayed, bool>) {
+    buffer->Append(value ? "1" : "0");
+  } else if constexpr (IsCharacter<Decayed>()) {
+    const char c = static_cast<char>(value);
+    buffer->Append(std::string_view(&c, 1));
+  } else if constexpr (std::is_integral_v<Decayed>) {
+    char digits[24];
+    auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    buffer->Append(std::string_view(digits, end - digits));
+  } else if constexpr (std::is_floating_point_v<Decayed>) {
+    // %g with 6 significant digits, the stream default
+    char digits[32];
+    auto end = std::to_chars(digits, digits + sizeof(digits), value,
+                             std::chars_format::general, 6)
+                   .ptr;
+    buffer->Append(std::string_view(digits, end - digits));
+  } else {
+    StringStreamWrapper ss;
+    ss.stream() << value;
+    buffer->Append(ss.str());
+  }
 }
 
+} // namespace detail
+
 template <typename... Args> std::string StringBuilder(Args &&...args) {
-  detail::StringStreamWrapper ss;
-  StringBuilderRecursive(ss.stream(), std::forward<Args>(args)...);
-  return ss.str();
+  detail::StringBuilderBuffer buffer;
+  (detail::StringBuilderAppend(&buffer, args), ...);
+  return std::move(buffer).str();
 }
 
 } // namespace util
@@ -206,6 +273,19 @@ public:
   }
 };
 
+/// \brief A place an error passed through on its way to the caller
+struct ErrorContext {
+  const char *file;
+  const char *function;
+  uint_least32_t line;
+  /// The expression that produced the error
+  const char *expr;
+};
+
+/// \brief How many ErrorContext entries a Status keeps, later ones are
+/// counted but dropped
+constexpr int kMaxErrorContext = 4;
+
 /// \brief Status outcome object (success or error)
 ///
 /// The Status object is an object holding the outcome of an operation.
@@ -431,27 +511,95 @@ public:
   /// \brief Return a new Status copying the existing status, but
   /// updating with the existing detail.
   Status WithDetail(std::shared_ptr<StatusDetail> new_detail) const {
-    return Status(code(), message(), std::move(new_detail));
+    Status status(code(), message(), std::move(new_detail));
+    status.CopyInlineDetail(*this);
+    return status;
   }
 
   /// \brief Return a new Status with changed message, copying the
   /// existing status code and detail.
   template <typename... Args> Status WithMessage(Args &&...args) const {
-    return FromArgs(code(), std::forward<Args>(args)...).WithDetail(detail());
+    Status status =
+        FromArgs(code(), std::forward<Args>(args)...).WithDetail(detail());
+    status.CopyInlineDetail(*this);
+    return status;
   }
 
+  /// \brief Return an IOError for a failed system call
+  template <typename... Args>
+  static Status IOErrorFromErrno(int error_number, Args &&...args) {
+    return IOError(std::forward<Args>(args)...).WithErrno(error_number);
+  }
+
+  /// \name Inline detail
+  ///
+  /// Common detail kept directly in the status so it can be checked without
+  /// allocating a StatusDetail or casting one.  All are empty for an OK
+  /// status, and setting them on one has no effect.
+  /// @{
+
+  /// \brief The errno of the system call that failed, or 0
+  int error_number() const { return ok() ? 0 : state_->error_number; }
+  /// \brief A subsystem-specific code refining code(), or 0
+  int32_t subcode() const { return ok() ? 0 : state_->subcode; }
+  /// \brief Whether the operation may succeed if tried again
+  bool retryable() const { return ok() ? false : state_->retryable; }
+
+  Status WithErrno(int error_number) const & {
+    return Status(*this).WithErrno(error_number);
+  }
+  Status WithErrno(int error_number) && {
+    if (!ok()) {
+      state_->error_number = error_number;
+    }
+    return std::move(*this);
+  }
+  Status WithSubcode(int32_t subcode) const & {
+    return Status(*this).WithSubcode(subcode);
+  }
+  Status WithSubcode(int32_t subcode) && {
+    if (!ok()) {
+      state_->subcode = subcode;
+    }
+    return std::move(*this);
+  }
+  Status WithRetryable(bool retryable = true) const & {
+    return Status(*this).WithRetryable(retryable);
+  }
+  Status WithRetryable(bool retryable = true) && {
+    if (!ok()) {
+      state_->retryable = retryable;
+    }
+    return std::move(*this);
+  }
+  /// @}
+
   [[noreturn]] void Abort() const;
   [[noreturn]] void Abort(const std::string &message) const;
 
-#ifdef ARROW_EXTRA_ERROR_CONTEXT
+  /// \brief Record that the error passed through `location`
+  ///
+  /// Used by ARROW_RETURN_NOT_OK and friends when ARROW_EXTRA_ERROR_CONTEXT is
+  /// defined.  Only the pointers are stored, in the status itself, so this
+  /// never allocates.  The context is formatted by ToString and is not part
+  /// of message().
+  void AddContext(const char *expr, std::source_location location =
+                                        std::source_location::current());
   void AddContextLine(const char *filename, int line, const char *expr);
-#endif
+
+  /// \brief The context recorded so far, innermost first
+  std::span<const ErrorContext> context() const;
 
 private:
   struct State {
     StatusCode code;
+    bool retryable = false;
+    int32_t error_number = 0;
+    int32_t subcode = 0;
     std::string msg;
     std::shared_ptr<StatusDetail> detail;
+    uint32_t num_context = 0;
+    std::array<ErrorContext, kMaxErrorContext> context;
   };
   // OK status has a `NULL` state_.  Otherwise, `state_` points to
   // a `State` structure containing the error code and message(s)
@@ -463,6 +611,16 @@ private:
   }
   void CopyFrom(const Status &s);
   inline void MoveFrom(Status &s);
+  // Carries the inline detail and context over to a rebuilt status
+  void CopyInlineDetail(const Status &s) {
+    if (!ok() && !s.ok()) {
+      state_->error_number = s.state_->error_number;
+      state_->subcode = s.state_->subcode;
+      state_->retryable = s.state_->retryable;
+      state_->num_context = s.state_->num_context;
+      state_->context = s.state_->context;
+    }
+  }
 };
 
 void Status::MoveFrom(Status &s) {
@@ -506,7 +664,9 @@ bool Status::Equals(const Status &s) const {
     return *detail() == *s.detail();
   }
 
-  return code() == s.code() && message() == s.message();
+  return code() == s.code() && message() == s.message() &&
+         error_number() == s.error_number() && subcode() == s.subcode() &&
+         retryable() == s.retryable();
 }
 
 /// \cond FALSE
@@ -0,0 +1,261 @@
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "batch_kernels.h"
+#include "perf_counters.h"
+#include "result_batch.h"
+#include "result.h"
+#include "status.h"
+
+namespace futures {
+
+static void BM_StatusOk(benchmark::State &state) {
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    Status status = Status::OK();
+    benchmark::DoNotOptimize(status);
+  }
+}
+BENCHMARK(BM_StatusOk);
+
+static void BM_StatusErrorNoMessage(benchmark::State &state) {
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    Status status(StatusCode::Invalid, std::string());
+    benchmark::DoNotOptimize(status);
+  }
+}
+BENCHMARK(BM_StatusErrorNoMessage);
+
+static void BM_StatusErrorFormatted(benchmark::State &state) {
+  int64_t index = 42;
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    Status status =
+        Status::IndexError("Index ", index, " out of bounds, length ", 3.5);
+    benchmark::DoNotOptimize(status);
+  }
+}
+BENCHMARK(BM_StatusErrorFormatted);
+
+static void BM_StatusCopy(benchmark::State &state) {
+  const Status error = Status::Invalid("some error");
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    Status copy = error;
+    benchmark::DoNotOptimize(copy);
+  }
+}
+BENCHMARK(BM_StatusCopy);
+
+static void BM_StatusMove(benchmark::State &state) {
+  Status error = Status::Invalid("some error");
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    Status moved = std::move(error);
+    benchmark::DoNotOptimize(moved);
+    error = std::move(moved);
+  }
+}
+BENCHMARK(BM_StatusMove);
+
+static void BM_StatusAndOk(benchmark::State &state) {
+  const Status ok = Status::OK();
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    Status combined = ok & ok;
+    benchmark::DoNotOptimize(combined);
+  }
+}
+BENCHMARK(BM_StatusAndOk);
+
+static void BM_StatusAndError(benchmark::State &state) {
+  const Status ok = Status::OK();
+  const Status error = Status::Invalid("some error");
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    Status combined = ok & error;
+    benchmark::DoNotOptimize(combined);
+  }
+}
+BENCHMARK(BM_StatusAndError);
+
+static void BM_StatusEquals(benchmark::State &state) {
+  const Status left = Status::Invalid("some error");
+  const Status right = Status::Invalid("some error");
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(left.Equals(right));
+  }
+}
+BENCHMARK(BM_StatusEquals);
+
+using SmallPayload = int;
+using LargePayload = std::array<int64_t, 32>;
+using SharedPayload = std::shared_ptr<int>;
+
+template <typename T> T MakePayload();
+template <> SmallPayload MakePayload<SmallPayload>() { return 7; }
+template <> LargePayload MakePayload<LargePayload>() { return {7}; }
+template <> SharedPayload MakePayload<SharedPayload>() {
+  return std::make_shared<int>(7);
+}
+
+template <typename T> static void BM_ResultConstruct(benchmark::State &state) {
+  const T payload = MakePayload<T>();
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    Result<T> result(payload);
+    benchmark::DoNotOptimize(result);
+  }
+}
+BENCHMARK_TEMPLATE(BM_ResultConstruct, SmallPayload);
+BENCHMARK_TEMPLATE(BM_ResultConstruct, LargePayload);
+BENCHMARK_TEMPLATE(BM_ResultConstruct, SharedPayload);
+
+template <typename T> static void BM_ResultMove(benchmark::State &state) {
+  Result<T> result(MakePayload<T>());
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    Result<T> moved = std::move(result);
+    benchmark::DoNotOptimize(moved);
+    result = std::move(moved);
+  }
+}
+BENCHMARK_TEMPLATE(BM_ResultMove, SmallPayload);
+BENCHMARK_TEMPLATE(BM_ResultMove, LargePayload);
+BENCHMARK_TEMPLATE(BM_ResultMove, SharedPayload);
+
+template <typename T> static void BM_ResultValueOrDie(benchmark::State &state) {
+  const Result<T> result(MakePayload<T>());
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(&result.ValueOrDie());
+  }
+}
+BENCHMARK_TEMPLATE(BM_ResultValueOrDie, SmallPayload);
+BENCHMARK_TEMPLATE(BM_ResultValueOrDie, LargePayload);
+BENCHMARK_TEMPLATE(BM_ResultValueOrDie, SharedPayload);
+
+template <typename T> static void BM_ResultMap(benchmark::State &state) {
+  const T payload = MakePayload<T>();
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    Result<T> result(payload);
+    Result<T> mapped = std::move(result).Map([](T value) { return value; });
+    benchmark::DoNotOptimize(mapped);
+  }
+}
+BENCHMARK_TEMPLATE(BM_ResultMap, SmallPayload);
+BENCHMARK_TEMPLATE(BM_ResultMap, LargePayload);
+BENCHMARK_TEMPLATE(BM_ResultMap, SharedPayload);
+
+template <typename T> static void BM_ResultMapError(benchmark::State &state) {
+  const Status error = Status::Invalid("some error");
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    Result<T> result(error);
+    Result<T> mapped = std::move(result).Map([](T value) { return value; });
+    benchmark::DoNotOptimize(mapped);
+  }
+}
+BENCHMARK_TEMPLATE(BM_ResultMapError, SmallPayload);
+BENCHMARK_TEMPLATE(BM_ResultMapError, LargePayload);
+BENCHMARK_TEMPLATE(BM_ResultMapError, SharedPayload);
+
+constexpr int64_t kBatchSize = 4096;
+
+// One error in the last 1% of the batch, the kernels have to scan almost all
+// of it
+ResultBatch<int32_t> MakeBatch() {
+  ResultBatch<int32_t> batch;
+  for (int64_t i = 0; i < kBatchSize; i++) {
+    if (i == kBatchSize - kBatchSize / 100) {
+      batch.AppendError(Status::Invalid("late error"));
+    } else {
+      batch.AppendValue(static_cast<int32_t>(i));
+    }
+  }
+  return batch;
+}
+
+// The row-at-a-time baseline for the batch kernels
+static void BM_ResultVectorScan(benchmark::State &state) {
+  auto results = MakeBatch().ToResults();
+  std::vector<int32_t> ok_values(kBatchSize);
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    size_t num_ok = 0;
+    Status first_error;
+    for (const auto &result : results) {
+      if (result.ok()) {
+        ok_values[num_ok++] = *result;
+      } else {
+        first_error &= result.status();
+      }
+    }
+    benchmark::DoNotOptimize(ok_values.data());
+    benchmark::DoNotOptimize(first_error);
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+BENCHMARK(BM_ResultVectorScan);
+
+// Argument is the SimdLevel
+static void BM_ResultBatchScan(benchmark::State &state) {
+  const auto level = static_cast<SimdLevel>(state.range(0));
+  if (level > DetectSimdLevel()) {
+    state.SkipWithError("not supported on this CPU");
+    return;
+  }
+  SetSimdLevel(level);
+  const auto batch = MakeBatch();
+  std::vector<int32_t> ok_values(kBatchSize);
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(CompactOk(batch, ok_values.data()));
+    const int64_t first_error = FindFirstError(batch);
+    benchmark::DoNotOptimize(first_error);
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+  SetSimdLevel(SimdLevel::AVX512);
+}
+BENCHMARK(BM_ResultBatchScan)->DenseRange(0, 2);
+
+// Argument is the SimdLevel
+static void BM_AggregateStatuses(benchmark::State &state) {
+  const auto level = static_cast<SimdLevel>(state.range(0));
+  if (level > DetectSimdLevel()) {
+    state.SkipWithError("not supported on this CPU");
+    return;
+  }
+  SetSimdLevel(level);
+  std::vector<Status> statuses(kBatchSize);
+  statuses.back() = Status::Invalid("late error");
+  ScopedPerfCounters counters(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(AggregateStatuses(statuses));
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+  SetSimdLevel(SimdLevel::AVX512);
+}
+BENCHMARK(BM_AggregateStatuses)->DenseRange(0, 2);
+
+} // namespace futures
+
+int main(int argc, char **argv) {
+  futures::ParsePerfCountersFlag(&argc, argv);
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
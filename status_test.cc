@@ -0,0 +1,183 @@
+// The context macros are only active with this defined
+#define ARROW_EXTRA_ERROR_CONTEXT
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include <gtest/gtest.h>
+
+#include "result.h"
+#include "status.h"
+
+// Counts allocations made on this thread so tests can check that a path does
+// not allocate
+thread_local int64_t num_allocations = 0;
+
+void *operator new(size_t size) {
+  num_allocations++;
+  if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+namespace futures {
+
+Status FailsInner() { return Status::Invalid("inner failure"); }
+
+Status FailsOuter() {
+  ARROW_RETURN_NOT_OK(FailsInner());
+  return Status::OK();
+}
+
+Result<int> FailsWithResult() {
+  ARROW_RETURN_NOT_OK(FailsOuter());
+  return 1;
+}
+
+TEST(StatusTest, ContextIsRecordedByMacros) {
+  Status status = FailsWithResult().status();
+  ASSERT_EQ("inner failure", status.message());
+  ASSERT_EQ(2, status.context().size());
+  ASSERT_STREQ("FailsInner()", status.context()[0].expr);
+  ASSERT_STREQ("FailsOuter()", status.context()[1].expr);
+  ASSERT_NE(nullptr, std::strstr(status.context()[0].function, "FailsOuter"));
+
+  const std::string text = status.ToString();
+  ASSERT_NE(std::string::npos, text.find("Invalid: inner failure\n"));
+  ASSERT_NE(std::string::npos, text.find("status_test.cc:"));
+  ASSERT_NE(std::string::npos, text.find("  FailsOuter()"));
+}
+
+Status FailsAfterHops(int hops) {
+  if (hops == 0) {
+    return Status::Invalid("inner failure");
+  }
+  ARROW_RETURN_NOT_OK(FailsAfterHops(hops - 1));
+  return Status::OK();
+}
+
+TEST(StatusTest, ContextDoesNotAllocatePerHop) {
+  const int64_t start = num_allocations;
+  Status status = FailsAfterHops(0);
+  const int64_t allocations_for_error = num_allocations - start;
+  for (int hops = 1; hops <= kMaxErrorContext + 2; hops++) {
+    const int64_t before = num_allocations;
+    status = FailsAfterHops(hops);
+    ASSERT_EQ(allocations_for_error, num_allocations - before) << hops;
+    ASSERT_EQ(std::min(hops, kMaxErrorContext),
+              static_cast<int>(status.context().size()));
+  }
+}
+
+TEST(StatusTest, ContextIsBounded) {
+  Status status = Status::IOError("disk");
+  for (int i = 0; i < kMaxErrorContext + 3; i++) {
+    status.AddContext("step");
+  }
+  ASSERT_EQ(kMaxErrorContext, status.context().size());
+  ASSERT_NE(std::string::npos, status.ToString().find("(3 more)"));
+
+  Status copy = status;
+  ASSERT_EQ(status.ToString(), copy.ToString());
+  ASSERT_TRUE(copy.Equals(Status::IOError("disk")));
+}
+
+TEST(StatusTest, AddContextLine) {
+  Status status = Status::Invalid("bad");
+  status.AddContextLine("file.cc", 12, "Call()");
+  ASSERT_EQ("Invalid: bad\nfile.cc:12  Call()", status.ToString());
+  ASSERT_TRUE(Status::OK().context().empty());
+}
+
+TEST(StatusTest, ContextSurvivesRebuild) {
+  Status status = FailsWithResult().status();
+  ASSERT_EQ(2, status.context().size());
+
+  Status with_message = status.WithMessage("outer failure");
+  ASSERT_EQ("outer failure", with_message.message());
+  ASSERT_EQ(2, with_message.context().size());
+  ASSERT_STREQ("FailsInner()", with_message.context()[0].expr);
+
+  Status with_detail = status.WithDetail(nullptr);
+  ASSERT_EQ(2, with_detail.context().size());
+  ASSERT_STREQ("FailsOuter()", with_detail.context()[1].expr);
+
+  // Each copy keeps its own context
+  with_detail.AddContext("Retry()");
+  ASSERT_EQ(3, with_detail.context().size());
+  ASSERT_EQ(2, status.context().size());
+  ASSERT_EQ(2, with_message.context().size());
+}
+
+TEST(StatusTest, InlineDetail) {
+  Status status = Status::IOErrorFromErrno(ENOENT, "open ", "/missing");
+  ASSERT_TRUE(status.IsIOError());
+  ASSERT_EQ(ENOENT, status.error_number());
+  ASSERT_EQ(0, status.subcode());
+  ASSERT_FALSE(status.retryable());
+  ASSERT_NE(std::string::npos,
+            status.ToString().find("open /missing [errno " +
+                                   std::to_string(ENOENT) + ": "));
+
+  Status busy = Status::Invalid("busy").WithSubcode(7).WithRetryable();
+  ASSERT_EQ(7, busy.subcode());
+  ASSERT_TRUE(busy.retryable());
+  ASSERT_EQ("Invalid: busy [subcode 7] [retryable]", busy.ToString());
+
+  // Copies and derived statuses keep the fields, and they take part in
+  // equality
+  Status copy = busy;
+  ASSERT_TRUE(copy.Equals(busy));
+  ASSERT_TRUE(busy.WithMessage("still busy").retryable());
+  ASSERT_FALSE(busy.Equals(Status::Invalid("busy").WithSubcode(7)));
+  ASSERT_FALSE(busy.WithRetryable(false).retryable());
+  ASSERT_TRUE(busy.retryable());
+
+  ASSERT_FALSE(Status::OK().WithRetryable().retryable());
+  ASSERT_EQ(0, Status::OK().WithErrno(EIO).error_number());
+}
+
+template <typename... Args> std::string Streamed(const Args &...args) {
+  std::ostringstream stream;
+  (stream << ... << args);
+  return stream.str();
+}
+
+TEST(StatusTest, StringBuilderMatchesStreams) {
+  const char *null_string = nullptr;
+  const std::string text = "text";
+  const std::string_view view = "view";
+  ASSERT_EQ(Streamed(1, -2, std::numeric_limits<int64_t>::min(),
+                     std::numeric_limits<uint64_t>::max()),
+            util::StringBuilder(1, -2, std::numeric_limits<int64_t>::min(),
+                                std::numeric_limits<uint64_t>::max()));
+  ASSERT_EQ(Streamed(0.1, 1.0 / 3, 1e20, 3.5f, 100.0, -0.0),
+            util::StringBuilder(0.1, 1.0 / 3, 1e20, 3.5f, 100.0, -0.0));
+  ASSERT_EQ(Streamed('c', static_cast<uint8_t>('d'), true, false),
+            util::StringBuilder('c', static_cast<uint8_t>('d'), true, false));
+  ASSERT_EQ(Streamed("literal", text, view),
+            util::StringBuilder("literal", null_string, text, view));
+  ASSERT_EQ(Streamed(Status::Invalid("x")),
+            util::StringBuilder(Status::Invalid("x")));
+  ASSERT_EQ("", util::StringBuilder());
+}
+
+TEST(StatusTest, StringBuilderLongMessage) {
+  const std::string chunk(100, 'a');
+  ASSERT_EQ(Streamed(chunk, 1, chunk, 2, chunk, 3, chunk),
+            util::StringBuilder(chunk, 1, chunk, 2, chunk, 3, chunk));
+}
+
+} // namespace futures